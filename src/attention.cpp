@@ -9,14 +9,28 @@ namespace attention {
 
 // [SLLM FIX] The redundant 'overlap' function definition has been removed from this file.
 
+static std::vector<PackedSdr> packAll(const std::vector<SDR>& sdrs) {
+    std::vector<PackedSdr> packed;
+    packed.reserve(sdrs.size());
+    for (const auto& sdr : sdrs) {
+        packed.push_back(PackedSdr::fromDense(sdr));
+    }
+    return packed;
+}
+
 // The existing getSparseAttentionSdr function is left unchanged for potential future use.
 AttentionOutput getSparseAttentionSdr(int current_sdr_idx, const std::vector<SDR>& all_sdrs, int k) {
+    PackedAttentionOutput packed = getSparseAttentionSdr(current_sdr_idx, packAll(all_sdrs), k);
+    return { packed.first.toDense(), packed.second.toDense() };
+}
+
+PackedAttentionOutput getSparseAttentionSdr(int current_sdr_idx, const std::vector<PackedSdr>& all_sdrs, int k) {
     if (all_sdrs.empty() || all_sdrs.size() <= 1) {
         int sdr_size = all_sdrs.empty() ? 0 : all_sdrs[0].size();
-        return { SDR(sdr_size, 0), SDR(sdr_size, 0) };
+        return { PackedSdr(sdr_size), PackedSdr(sdr_size) };
     }
 
-    const SDR& target_sdr = all_sdrs[current_sdr_idx];
+    const PackedSdr& target_sdr = all_sdrs[current_sdr_idx];
     int num_sdrs = all_sdrs.size();
     int sdr_size = target_sdr.size();
 
@@ -33,7 +47,7 @@ AttentionOutput getSparseAttentionSdr(int current_sdr_idx, const std::vector<SDR
     int num_neighbors = num_sdrs - 1;
     int actual_k = std::min(k, num_neighbors);
     if (actual_k <= 0) {
-        return { SDR(sdr_size, 0), SDR(sdr_size, 0) };
+        return { PackedSdr(sdr_size), PackedSdr(sdr_size) };
     }
     
     std::vector<int> indices(num_sdrs);
@@ -49,48 +63,36 @@ AttentionOutput getSparseAttentionSdr(int current_sdr_idx, const std::vector<SDR
     }
 
     if (top_k_indices.empty()) {
-        return { SDR(sdr_size, 0), SDR(sdr_size, 0) };
-    }
-    
-    std::vector<int> bit_counts(sdr_size, 0);
-    for (int neighbor_idx : top_k_indices) {
-        for (int bit = 0; bit < sdr_size; ++bit) {
-            if (all_sdrs[neighbor_idx][bit] == 1) {
-                bit_counts[bit]++;
-            }
-        }
+        return { PackedSdr(sdr_size), PackedSdr(sdr_size) };
     }
-    SDR resonance_sdr(sdr_size, 0);
-    int consensus_threshold = 1; 
-    for(int bit = 0; bit < sdr_size; ++bit) {
-        if (bit_counts[bit] > consensus_threshold) {
-            resonance_sdr[bit] = 1;
-        }
-    }
-    SDR union_sdr(sdr_size, 0);
+
+    // Consensus bits are those set in at least two neighbours: track "seen once"
+    // (the union) and "seen twice" (the resonance) as running bit sets.
+    PackedSdr union_sdr(sdr_size);
+    PackedSdr resonance_sdr(sdr_size);
     for (int neighbor_idx : top_k_indices) {
-        for (int bit = 0; bit < sdr_size; ++bit) {
-            union_sdr[bit] = union_sdr[bit] | all_sdrs[neighbor_idx][bit];
-        }
-    }
-    SDR dissonance_sdr(sdr_size, 0);
-    for (int bit = 0; bit < sdr_size; ++bit) {
-        if (union_sdr[bit] == 1 && resonance_sdr[bit] == 0) {
-            dissonance_sdr[bit] = 1;
-        }
+        const PackedSdr& neighbor = all_sdrs[neighbor_idx];
+        resonance_sdr |= (union_sdr & neighbor);
+        union_sdr |= neighbor;
     }
+    PackedSdr dissonance_sdr = union_sdr;
+    dissonance_sdr.andNot(resonance_sdr);
     return { resonance_sdr, dissonance_sdr };
 }
 
 
 // --- [SLLM] Implementation of getResonanceVector (Unchanged) ---
 VectorXf getResonanceVector(const std::vector<SDR>& history, int k) {
+    return getResonanceVector(packAll(history), k);
+}
+
+VectorXf getResonanceVector(const std::vector<PackedSdr>& history, int k) {
     if (history.empty() || history.size() <= 1) {
         int sdr_size = history.empty() ? 0 : history[0].size();
         return VectorXf::Zero(sdr_size);
     }
 
-    const SDR& target_sdr = history.back(); // Use the most recent SDR as the query
+    const PackedSdr& target_sdr = history.back(); // Use the most recent SDR as the query
     int num_sdrs = history.size();
     int sdr_size = target_sdr.size();
 
@@ -118,12 +120,7 @@ VectorXf getResonanceVector(const std::vector<SDR>& history, int k) {
     int valid_neighbors = 0;
     for(int i = 0; i < actual_k; ++i) {
         if (overlaps[indices[i]] > 0) { // Only consider meaningful overlaps
-            const SDR& neighbor_sdr = history[indices[i]];
-            for(int bit = 0; bit < sdr_size; ++bit) {
-                if(neighbor_sdr[bit] == 1) {
-                    resonance_vector(bit) += 1.0f;
-                }
-            }
+            history[indices[i]].forEachActive([&resonance_vector](int bit) { resonance_vector(bit) += 1.0f; });
             valid_neighbors++;
         }
     }
@@ -3,6 +3,7 @@
 #define ATTENTION_HPP
 
 #include "types.hpp" // [SLLM MODIFIED] Use the project-wide types
+#include "packed_sdr.hpp"
 #include <vector>
 #include <utility> 
 
@@ -14,6 +15,10 @@ using AttentionOutput = std::pair<SDR, SDR>;
 // This function can remain for other potential uses
 AttentionOutput getSparseAttentionSdr(int current_sdr_idx, const std::vector<SDR>& all_sdrs, int k);
 
+// Packed form of the above; the dense overload packs its input once and forwards here.
+using PackedAttentionOutput = std::pair<PackedSdr, PackedSdr>;
+PackedAttentionOutput getSparseAttentionSdr(int current_sdr_idx, const std::vector<PackedSdr>& all_sdrs, int k);
+
 /**
  * @brief [SLLM ADDED] Creates a weighted "resonance" vector from a history of SDRs.
  * This represents the consensus or "gist" of the recent context.
@@ -23,6 +28,7 @@ AttentionOutput getSparseAttentionSdr(int current_sdr_idx, const std::vector<SDR
  * @return A VectorXf where each element's value represents its strength in the consensus.
  */
 VectorXf getResonanceVector(const std::vector<SDR>& history, int k);
+VectorXf getResonanceVector(const std::vector<PackedSdr>& history, int k);
 
 } // namespace attention
 
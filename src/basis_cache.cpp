@@ -0,0 +1,165 @@
+// src/basis_cache.cpp
+#include "basis_cache.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kMagic[8] = {'D', 'A', 'O', 'B', 'A', 'S', 'I', 'S'};
+const uint32_t kFormatVersion = 1;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t max_active;
+    uint64_t key;
+    uint64_t num_positions;
+    uint32_t num_columns;
+    uint32_t reserved;
+};
+
+std::size_t recordLength(int max_active) {
+    return static_cast<std::size_t>(max_active) + 1; // count + indices, in uint16s
+}
+
+} // namespace
+
+BasisCache::~BasisCache() {
+    unmap();
+}
+
+BasisCache::BasisCache(BasisCache&& other) noexcept {
+    *this = std::move(other);
+}
+
+BasisCache& BasisCache::operator=(BasisCache&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        data_ = other.data_;
+        mapped_bytes_ = other.mapped_bytes_;
+        records_ = other.records_;
+        num_positions_ = other.num_positions_;
+        num_columns_ = other.num_columns_;
+        max_active_ = other.max_active_;
+        other.data_ = nullptr;
+        other.mapped_bytes_ = 0;
+        other.records_ = nullptr;
+        other.num_positions_ = 0;
+    }
+    return *this;
+}
+
+void BasisCache::unmap() {
+    if (data_) munmap(data_, mapped_bytes_);
+    data_ = nullptr;
+    records_ = nullptr;
+    mapped_bytes_ = 0;
+}
+
+bool BasisCache::map(const std::string& path, uint64_t key, int num_columns, int max_active, std::size_t num_positions) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat file_stat;
+    const std::size_t expected_bytes =
+        sizeof(FileHeader) + num_positions * recordLength(max_active) * sizeof(uint16_t);
+    if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) != expected_bytes) {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, expected_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.format_version != kFormatVersion ||
+        header.key != key || header.num_positions != num_positions ||
+        header.num_columns != static_cast<uint32_t>(num_columns) || header.max_active != static_cast<uint32_t>(max_active)) {
+        munmap(data, expected_bytes);
+        return false;
+    }
+    // Training reads the records front to back.
+    madvise(data, expected_bytes, MADV_SEQUENTIAL);
+
+    unmap();
+    data_ = data;
+    mapped_bytes_ = expected_bytes;
+    records_ = reinterpret_cast<const uint16_t*>(static_cast<const char*>(data) + sizeof(FileHeader));
+    num_positions_ = num_positions;
+    num_columns_ = num_columns;
+    max_active_ = max_active;
+    return true;
+}
+
+BasisCache BasisCache::openOrBuild(const std::string& path, uint64_t key, int num_columns, int max_active,
+                                   std::size_t num_positions, const BlockBuilder& build_block, std::size_t block_size) {
+    if (!supports(num_columns) || max_active <= 0) {
+        throw std::invalid_argument("BasisCache needs 0 < num_columns <= 65536 and max_active > 0.");
+    }
+    BasisCache cache;
+    if (cache.map(path, key, num_columns, max_active, num_positions)) return cache;
+
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream os(temp_path, std::ios::binary | std::ios::trunc);
+        if (!os) throw std::runtime_error("Could not create basis cache file: " + temp_path);
+
+        FileHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.format_version = kFormatVersion;
+        header.max_active = static_cast<uint32_t>(max_active);
+        header.key = key;
+        header.num_positions = num_positions;
+        header.num_columns = static_cast<uint32_t>(num_columns);
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::vector<SparseSdr> block;
+        std::vector<uint16_t> records;
+        for (std::size_t begin = 0; begin < num_positions; begin += block_size) {
+            const std::size_t end = std::min(num_positions, begin + block_size);
+            build_block(begin, end, block);
+            if (block.size() != end - begin) {
+                throw std::runtime_error("BasisCache block builder returned the wrong number of SDRs.");
+            }
+            records.assign(block.size() * recordLength(max_active), 0);
+            for (std::size_t p = 0; p < block.size(); ++p) {
+                const auto& active = block[p].active;
+                if (static_cast<int>(active.size()) > max_active) {
+                    throw std::runtime_error("Basis SDR has more active columns than the cache record holds.");
+                }
+                uint16_t* record = records.data() + p * recordLength(max_active);
+                record[0] = static_cast<uint16_t>(active.size());
+                for (std::size_t a = 0; a < active.size(); ++a) {
+                    record[a + 1] = static_cast<uint16_t>(active[a]);
+                }
+            }
+            os.write(reinterpret_cast<const char*>(records.data()),
+                     static_cast<std::streamsize>(records.size() * sizeof(uint16_t)));
+        }
+        if (!os) throw std::runtime_error("Failed writing basis cache file: " + temp_path);
+    }
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Could not move basis cache into place: " + path);
+    }
+    if (!cache.map(path, key, num_columns, max_active, num_positions)) {
+        throw std::runtime_error("Could not map freshly written basis cache: " + path);
+    }
+    return cache;
+}
+
+void BasisCache::get(std::size_t position, SparseSdr& out) const {
+    if (position >= num_positions_) {
+        throw std::out_of_range("BasisCache position out of range.");
+    }
+    const uint16_t* record = records_ + position * recordLength(max_active_);
+    out.size = num_columns_;
+    out.active.assign(record + 1, record + 1 + record[0]);
+}
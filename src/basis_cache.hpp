@@ -0,0 +1,65 @@
+// src/basis_cache.hpp
+#ifndef BASIS_CACHE_HPP
+#define BASIS_CACHE_HPP
+
+#include "sparse_sdr.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A memory-mapped file of precomputed basis SDRs (SP winners), one per position.
+ *
+ * With a frozen SpatialPooler the basis SDR of corpus position i depends only on the
+ * token at i and on the position itself, so it is the same in every epoch and every run
+ * with the same model. The file stores it once as fixed-size records (a uint16 count
+ * followed by `max_active` uint16 column indices), so position i is a direct offset.
+ *
+ * The header carries a caller-supplied key (a hash of everything the SDRs depend on);
+ * a file whose key does not match is rebuilt.
+ */
+class BasisCache {
+public:
+    // Fills `out` with the basis SDRs of positions [begin, end).
+    using BlockBuilder = std::function<void(std::size_t begin, std::size_t end, std::vector<SparseSdr>& out)>;
+
+    BasisCache() = default;
+    ~BasisCache();
+    BasisCache(BasisCache&& other) noexcept;
+    BasisCache& operator=(BasisCache&& other) noexcept;
+    BasisCache(const BasisCache&) = delete;
+    BasisCache& operator=(const BasisCache&) = delete;
+
+    // Indices are stored as uint16.
+    static bool supports(int num_columns) { return num_columns > 0 && num_columns <= 65536; }
+
+    /**
+     * @brief Maps `path` if it holds `num_positions` SDRs under `key`; otherwise builds it
+     * block by block with `build_block`, writes it (via a temporary file) and maps that.
+     */
+    static BasisCache openOrBuild(const std::string& path, uint64_t key, int num_columns, int max_active,
+                                  std::size_t num_positions, const BlockBuilder& build_block,
+                                  std::size_t block_size = 4096);
+
+    bool isOpen() const { return data_ != nullptr; }
+    std::size_t size() const { return num_positions_; }
+    int getNumColumns() const { return num_columns_; }
+
+    // Copies position `position`'s SDR into `out`, reusing its storage.
+    void get(std::size_t position, SparseSdr& out) const;
+
+private:
+    bool map(const std::string& path, uint64_t key, int num_columns, int max_active, std::size_t num_positions);
+    void unmap();
+
+    void* data_ = nullptr;
+    std::size_t mapped_bytes_ = 0;
+    const uint16_t* records_ = nullptr;
+    std::size_t num_positions_ = 0;
+    int num_columns_ = 0;
+    int max_active_ = 0;
+};
+
+#endif // BASIS_CACHE_HPP
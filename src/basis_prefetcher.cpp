@@ -0,0 +1,91 @@
+// src/basis_prefetcher.cpp
+#include "basis_prefetcher.hpp"
+#include <algorithm>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+BasisPrefetcher::BasisPrefetcher(long long num_chunks, ChunkBuilder builder, int depth, int workers)
+    : num_chunks_(num_chunks),
+      builder_(std::move(builder)),
+      depth_(std::max(depth, 1)),
+      slots_(new Slot[std::max(depth, 1)]) {
+
+    for (int w = 0; w < workers; ++w) {
+        workers_.emplace_back(&BasisPrefetcher::workerLoop, this);
+    }
+}
+
+BasisPrefetcher::~BasisPrefetcher() {
+    shutdown();
+}
+
+void BasisPrefetcher::notify(std::condition_variable& condition) {
+    // Taking the mutex orders the state change before any waiter's predicate check, so a
+    // waiter that has just found the predicate false cannot miss this wake-up.
+    { std::lock_guard<std::mutex> lock(wait_mutex_); }
+    condition.notify_all();
+}
+
+void BasisPrefetcher::shutdown() {
+    stop_.store(true, std::memory_order_release);
+    notify(slot_released_);
+    notify(chunk_ready_);
+    for (auto& worker : workers_) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+void BasisPrefetcher::workerLoop() {
+#ifdef _OPENMP
+    // Parallelism comes from the workers themselves; nested OpenMP teams would oversubscribe.
+    omp_set_num_threads(1);
+#endif
+    while (!stop_.load(std::memory_order_acquire)) {
+        const long long chunk_index = next_to_build_.fetch_add(1, std::memory_order_relaxed);
+        if (chunk_index >= num_chunks_) return;
+
+        // The slot is free once the chunk `depth_` places earlier has been released.
+        if (chunk_index >= released_.load(std::memory_order_acquire) + depth_) {
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            slot_released_.wait(lock, [&]() {
+                return stop_.load(std::memory_order_acquire) ||
+                       chunk_index < released_.load(std::memory_order_acquire) + depth_;
+            });
+            if (stop_.load(std::memory_order_acquire)) return;
+        }
+
+        Slot& slot = slots_[chunk_index % depth_];
+        slot.error = nullptr;
+        try {
+            builder_(chunk_index, slot.chunk);
+        } catch (...) {
+            slot.error = std::current_exception();
+        }
+        slot.ready.store(chunk_index, std::memory_order_release);
+        notify(chunk_ready_);
+    }
+}
+
+const PrefetchedChunk& BasisPrefetcher::next() {
+    if (next_to_consume_ >= num_chunks_) {
+        throw std::out_of_range("BasisPrefetcher has no chunks left.");
+    }
+    const long long chunk_index = next_to_consume_++;
+    // Returning chunk k means the caller is done with chunk k - 1.
+    released_.store(chunk_index, std::memory_order_release);
+    if (!workers_.empty()) notify(slot_released_);
+
+    Slot& slot = slots_[chunk_index % depth_];
+    if (workers_.empty()) {
+        builder_(chunk_index, slot.chunk);
+        return slot.chunk;
+    }
+    if (slot.ready.load(std::memory_order_acquire) != chunk_index) {
+        std::unique_lock<std::mutex> lock(wait_mutex_);
+        chunk_ready_.wait(lock, [&]() { return slot.ready.load(std::memory_order_acquire) == chunk_index; });
+    }
+    if (slot.error) std::rethrow_exception(slot.error);
+    return slot.chunk;
+}
@@ -0,0 +1,84 @@
+// src/basis_prefetcher.hpp
+#ifndef BASIS_PREFETCHER_HPP
+#define BASIS_PREFETCHER_HPP
+
+#include "sparse_sdr.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One training chunk with the parameter-independent work (encoding and the frozen SP) done.
+struct PrefetchedChunk {
+    std::vector<SparseSdr> basis_sdrs; // Column t*B + b, as TemporalMemory::forwardSequence expects
+    std::vector<int64_t> targets;
+    std::vector<int64_t> columns; // Sorted distinct basis columns active anywhere in the chunk
+    std::vector<int64_t> negatives; // Sampled-softmax negatives shared by the chunk's rows
+    std::vector<int64_t> vocab_rows; // Sorted distinct targets and negatives (sampled softmax only)
+    std::vector<int64_t> target_slots; // Index of each target in vocab_rows
+    std::vector<int64_t> negative_slots; // Index of each negative in vocab_rows
+};
+
+/**
+ * @brief Builds training chunks on worker threads ahead of the optimizer.
+ *
+ * Chunks are produced into a bounded ring of `depth` slots and handed out strictly in
+ * order. A worker claims the next chunk index with a fetch_add, waits until the consumer
+ * has released the chunk that last used its slot, fills the slot and publishes it with a
+ * release store of the chunk index. Both checks are plain atomic loads, so as long as the
+ * workers keep up, next() finds its chunk already published and never takes the lock.
+ * When the ring is full (workers) or the chunk is not ready yet (consumer), the side that
+ * has to wait blocks on a condition variable instead of spinning, so idle workers leave
+ * the cores to the trainer's own threads.
+ *
+ * With `workers == 0` nothing runs in the background and next() builds the chunk inline.
+ */
+class BasisPrefetcher {
+public:
+    // Fills `out` with chunk `chunk_index`. Called concurrently from several workers.
+    using ChunkBuilder = std::function<void(long long chunk_index, PrefetchedChunk& out)>;
+
+    BasisPrefetcher(long long num_chunks, ChunkBuilder builder, int depth, int workers);
+    ~BasisPrefetcher();
+
+    BasisPrefetcher(const BasisPrefetcher&) = delete;
+    BasisPrefetcher& operator=(const BasisPrefetcher&) = delete;
+
+    // The next chunk in order. The reference stays valid until the following call.
+    // Rethrows anything the builder threw for that chunk.
+    const PrefetchedChunk& next();
+
+    // Stops the workers (after their current chunk) and joins them; also run by the destructor.
+    void shutdown();
+
+private:
+    struct Slot {
+        std::atomic<long long> ready{-1}; // Index of the chunk published in this slot
+        PrefetchedChunk chunk;
+        std::exception_ptr error;
+    };
+
+    void workerLoop();
+    // Wakes the threads blocked on `condition` after a state change they wait for.
+    void notify(std::condition_variable& condition);
+
+    long long num_chunks_;
+    ChunkBuilder builder_;
+    int depth_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<long long> next_to_build_{0};
+    std::atomic<long long> released_{0}; // Chunks [0, released_) are done with
+    std::atomic<bool> stop_{false};
+    long long next_to_consume_ = 0;
+    std::mutex wait_mutex_;
+    std::condition_variable slot_released_; // Workers wait here while the ring is full
+    std::condition_variable chunk_ready_;   // next() waits here for its chunk
+    std::vector<std::thread> workers_;
+};
+
+#endif // BASIS_PREFETCHER_HPP
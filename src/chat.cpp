@@ -23,7 +23,19 @@ std::string find_first_txt_file(const std::string& directory) {
     return "";
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // `--int8` serves CPU generation from int8 weights; the default stays float32.
+    WeightPrecision precision = WeightPrecision::Float32;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--int8") {
+            precision = WeightPrecision::Int8;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--int8]" << std::endl;
+            return 1;
+        }
+    }
+
     // [SLLM MODIFIED] Add more detailed CUDA logging.
     torch::Device device(torch::kCPU);
     if (torch::cuda::is_available()) {
@@ -70,7 +82,8 @@ int main() {
         val_buffer << val_file.rdbuf();
         auto validation_token_ids = encoder.tokenize(val_buffer.str());
 
-        train_model(model, encoder, corpus_token_ids, validation_token_ids);
+        TrainingConfig training_config;
+        train_model(model, encoder, corpus_token_ids, validation_token_ids, training_config);
     }
 
     EmotionConfig emotion_config;
@@ -81,7 +94,10 @@ int main() {
     std::vector<TemporalMemory*> tm_ptrs;
     for (auto &tm : model.temporal_memories) tm_ptrs.push_back(&tm);
 
-    ConversationalGenerator generator(&encoder, &sp_ptrs, &rl_ptrs, &tm_ptrs, model.vocab_matrix, emotion_config, device);
+    // CPU generation streams the weights once per token; --int8 quarters that stream at a
+    // small accuracy cost (TrainingConfig::report_quantization measures it after training).
+    ConversationalGenerator generator(&encoder, &sp_ptrs, &rl_ptrs, &tm_ptrs, model.vocab_matrix, emotion_config, device,
+                                      precision);
 
     std::string user_input;
     generator.startNewConversation();
@@ -94,8 +110,11 @@ int main() {
             continue;
         }
         std::cout << "DAO: " << std::flush;
-        std::string response = generator.respondTo(user_input);
-        std::cout << response << std::endl;
+        generator.respondTo(user_input, 50, [](const std::string& text) {
+            std::cout << text << std::flush;
+            return true;
+        });
+        std::cout << std::endl;
     }
 
     return 0;
@@ -0,0 +1,186 @@
+// src/checkpoint.cpp
+#include "checkpoint.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// A host copy that later in-place updates of `tensor` (optimizer steps) cannot reach.
+torch::Tensor hostCopy(const torch::Tensor& tensor) {
+    return tensor.detach().to(torch::kCPU, tensor.scalar_type(), /*non_blocking=*/false, /*copy=*/true);
+}
+
+// Flushes `path` (a file or a directory) to stable storage.
+void syncPath(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open for fsync: " + path);
+    const int result = ::fsync(fd);
+    ::close(fd);
+    if (result != 0) throw std::runtime_error("fsync failed: " + path);
+}
+
+std::string adamKey(const char* field, const std::string& parameter) {
+    return std::string("adam_") + field + "_" + parameter;
+}
+
+} // namespace
+
+CheckpointWriter::~CheckpointWriter() {
+    try {
+        wait();
+    } catch (const std::exception& e) {
+        std::cerr << "Error writing checkpoint: " << e.what() << std::endl;
+    }
+}
+
+void CheckpointWriter::wait() {
+    if (writer_.joinable()) writer_.join();
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void CheckpointWriter::startWrite(const std::string& path, Snapshot snapshot) {
+    writer_ = std::thread([this, path, snapshot = std::move(snapshot)]() {
+        try {
+            torch::serialize::OutputArchive archive;
+            for (const auto& named : snapshot) {
+                archive.write(named.first, named.second);
+            }
+            const std::string temp_path = path + ".tmp";
+            archive.save_to(temp_path);
+            // The data must be durable before the rename publishes it, and the rename itself
+            // (a directory entry) before the write counts as done.
+            syncPath(temp_path);
+            if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+                throw std::runtime_error("Could not move checkpoint into place: " + path);
+            }
+            const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+            syncPath(directory.empty() ? "." : directory.string());
+        } catch (...) {
+            error_ = std::current_exception();
+        }
+    });
+}
+
+void CheckpointWriter::saveModel(const std::string& path, const DaoModel& model) {
+    wait();
+    Snapshot snapshot;
+    for (const auto& named : model.namedTensors()) {
+        snapshot.emplace_back(named.first, hostCopy(named.second));
+    }
+    startWrite(path, std::move(snapshot));
+}
+
+void CheckpointWriter::save(const std::string& path, const DaoModel& model,
+                            const std::vector<std::pair<std::string, torch::Tensor>>& parameters,
+                            torch::optim::Adam& optimizer, const TrainingState& state,
+                            const std::vector<std::pair<std::string, torch::Tensor>>& extra_state) {
+    wait();
+    Snapshot snapshot;
+    for (const auto& named : model.namedTensors()) {
+        snapshot.emplace_back(named.first, hostCopy(named.second));
+    }
+
+    // Adam keeps its per-parameter state keyed by tensor identity; store it under the
+    // parameter's name instead, which survives a restart and changes to the parameter list.
+    auto& optimizer_state = optimizer.state();
+    for (const auto& parameter : parameters) {
+        auto found = optimizer_state.find(parameter.second.unsafeGetTensorImpl());
+        if (found == optimizer_state.end()) continue;
+        auto& adam_state = static_cast<torch::optim::AdamParamState&>(*found->second);
+        snapshot.emplace_back(adamKey("step", parameter.first), torch::tensor(std::vector<int64_t>{adam_state.step()}));
+        snapshot.emplace_back(adamKey("exp_avg", parameter.first), hostCopy(adam_state.exp_avg()));
+        snapshot.emplace_back(adamKey("exp_avg_sq", parameter.first), hostCopy(adam_state.exp_avg_sq()));
+    }
+
+    for (const auto& named : extra_state) {
+        snapshot.emplace_back(named.first, hostCopy(named.second));
+    }
+
+    snapshot.emplace_back("training_state", torch::tensor(std::vector<int64_t>{
+        state.epoch, state.next_chunk, state.epochs_without_improvement, static_cast<int64_t>(state.fingerprint),
+        state.attempted_tokens, state.step}));
+    snapshot.emplace_back("training_best_accuracy", torch::tensor(std::vector<double>{state.best_validation_accuracy}));
+    if (state.next_chunk > 0) {
+        snapshot.emplace_back("training_hidden", hostCopy(state.hidden));
+        snapshot.emplace_back("training_loss_sum", hostCopy(state.loss_sum));
+        snapshot.emplace_back("training_token_count", hostCopy(state.token_count));
+        snapshot.emplace_back("training_skipped_chunks", hostCopy(state.skipped_chunks));
+    }
+    startWrite(path, std::move(snapshot));
+}
+
+CheckpointReader::CheckpointReader(const std::string& path) {
+    archive_.load_from(path);
+}
+
+void CheckpointReader::restoreModel(DaoModel& model, torch::Device device) {
+    model.load(archive_, device);
+}
+
+TrainingState CheckpointReader::restoreState(torch::Device device) {
+    TrainingState state;
+    torch::Tensor values;
+    archive_.read("training_state", values);
+    if (values.numel() != 6) {
+        throw std::runtime_error("Checkpoint training state has an unexpected layout.");
+    }
+    torch::Tensor counters = values.to(torch::kLong).contiguous();
+    const int64_t* v = counters.data_ptr<int64_t>();
+    state.epoch = static_cast<int>(v[0]);
+    state.next_chunk = v[1];
+    state.epochs_without_improvement = static_cast<int>(v[2]);
+    state.fingerprint = static_cast<uint64_t>(v[3]);
+    state.attempted_tokens = v[4];
+    state.step = v[5];
+
+    torch::Tensor best;
+    archive_.read("training_best_accuracy", best);
+    state.best_validation_accuracy = best.to(torch::kDouble).contiguous().data_ptr<double>()[0];
+
+    if (state.next_chunk > 0) {
+        archive_.read("training_hidden", state.hidden);
+        archive_.read("training_loss_sum", state.loss_sum);
+        archive_.read("training_token_count", state.token_count);
+        archive_.read("training_skipped_chunks", state.skipped_chunks);
+        state.hidden = state.hidden.to(device);
+        state.loss_sum = state.loss_sum.to(device);
+        state.token_count = state.token_count.to(device);
+        state.skipped_chunks = state.skipped_chunks.to(device);
+    }
+    return state;
+}
+
+void CheckpointReader::restoreOptimizer(const std::vector<std::pair<std::string, torch::Tensor>>& parameters,
+                                        torch::optim::Adam& optimizer, torch::Device device) {
+    auto& optimizer_state = optimizer.state();
+    for (const auto& parameter : parameters) {
+        torch::Tensor step, exp_avg, exp_avg_sq;
+        if (!archive_.try_read(adamKey("step", parameter.first), step)) continue; // Not stepped yet when saved
+        archive_.read(adamKey("exp_avg", parameter.first), exp_avg);
+        archive_.read(adamKey("exp_avg_sq", parameter.first), exp_avg_sq);
+        if (exp_avg.sizes() != parameter.second.sizes()) {
+            throw std::runtime_error("Checkpoint optimizer state does not match parameter " + parameter.first + ".");
+        }
+
+        auto adam_state = std::make_unique<torch::optim::AdamParamState>();
+        adam_state->step(step.to(torch::kLong).contiguous().data_ptr<int64_t>()[0]);
+        adam_state->exp_avg(exp_avg.to(device));
+        adam_state->exp_avg_sq(exp_avg_sq.to(device));
+        optimizer_state[parameter.second.unsafeGetTensorImpl()] = std::move(adam_state);
+    }
+}
+
+bool CheckpointReader::tryRead(const std::string& name, torch::Tensor& tensor) {
+    // Reading into a defined tensor would overwrite its storage in place (and with it any
+    // tensor sharing it), so always read into a fresh one.
+    tensor = torch::Tensor();
+    return archive_.try_read(name, tensor);
+}
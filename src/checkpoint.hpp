@@ -0,0 +1,100 @@
+// src/checkpoint.hpp
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include "dao_model.hpp"
+#include <torch/torch.h>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// The training-loop position and counters a checkpoint restores, besides the model and Adam.
+struct TrainingState {
+    int epoch = 0;              // Epoch in progress (or the next one to start)
+    long long next_chunk = 0;   // Chunks of `epoch` already trained; 0 = start of the epoch
+    int epochs_without_improvement = 0;
+    double best_validation_accuracy = -1.0;
+    // Identifies the run the checkpoint belongs to (corpus, vocabulary, mini-batch layout and
+    // optimizer setup); the trainer only resumes a checkpoint whose fingerprint matches its own.
+    uint64_t fingerprint = 0;
+
+    // Mid-epoch only: the recurrent state carried into the next chunk and the epoch's
+    // device-side metric accumulators.
+    torch::Tensor hidden;
+    torch::Tensor loss_sum;
+    torch::Tensor token_count;
+    torch::Tensor skipped_chunks;
+    long long attempted_tokens = 0;
+    long long step = 0;
+};
+
+/**
+ * @brief Writes training checkpoints on a background thread.
+ *
+ * save() copies the model, the Adam moments and the loop state to host memory on the
+ * calling thread (the only part that has to see a consistent state), then returns while a
+ * writer thread serializes the copy to `path + ".tmp"`, fsyncs it, renames it over `path`
+ * and fsyncs the directory, so neither a process crash nor power loss mid-write leaves a
+ * truncated checkpoint (POSIX filesystems). One write is in flight at a time:
+ * a new save() first waits for the previous one.
+ *
+ * A checkpoint holds the model under the same keys as DaoModel::save, so it also loads
+ * as a plain model file. Callers with a lazy optimizer (SparseColumnAdam) flush it before
+ * save() so the weights written are fully updated.
+ */
+class CheckpointWriter {
+public:
+    CheckpointWriter() = default;
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // `parameters` are the optimizer's parameters under stable names (their DaoModel::namedTensors()
+    // keys), which key their Adam state in the file. `extra_state` holds any further named tensors
+    // (e.g. SparseColumnAdam::namedState()), snapshotted the same way.
+    void save(const std::string& path, const DaoModel& model,
+              const std::vector<std::pair<std::string, torch::Tensor>>& parameters,
+              torch::optim::Adam& optimizer, const TrainingState& state,
+              const std::vector<std::pair<std::string, torch::Tensor>>& extra_state = {});
+    // A model-only file (DaoModel::save format), written the same way.
+    void saveModel(const std::string& path, const DaoModel& model);
+
+    // Blocks until the pending write is on disk; rethrows its error, if any.
+    void wait();
+
+private:
+    using Snapshot = std::vector<std::pair<std::string, torch::Tensor>>;
+    void startWrite(const std::string& path, Snapshot snapshot);
+
+    std::thread writer_;
+    std::exception_ptr error_;
+};
+
+/**
+ * @brief Reads a checkpoint written by CheckpointWriter.
+ *
+ * restoreState can be read first, to check the fingerprint before anything is replaced. The
+ * model is restored next (its tensors are replaced, so the optimizer must be built afterwards
+ * over the new ones), then restoreOptimizer fills in that optimizer's moments.
+ */
+class CheckpointReader {
+public:
+    explicit CheckpointReader(const std::string& path);
+
+    void restoreModel(DaoModel& model, torch::Device device);
+    TrainingState restoreState(torch::Device device);
+    // `parameters` are named as for CheckpointWriter::save; each is matched to its saved state by name.
+    void restoreOptimizer(const std::vector<std::pair<std::string, torch::Tensor>>& parameters,
+                          torch::optim::Adam& optimizer, torch::Device device);
+    // Reads one of the extra_state tensors; false if the checkpoint does not have it.
+    bool tryRead(const std::string& name, torch::Tensor& tensor);
+
+private:
+    torch::serialize::InputArchive archive_;
+};
+
+#endif // CHECKPOINT_HPP
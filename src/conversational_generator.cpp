@@ -1,7 +1,6 @@
 // src/conversational_generator.cpp
 #include "conversational_generator.hpp"
 #include <iostream>
-#include <limits>
 #include <iomanip>
 
 ConversationalGenerator::ConversationalGenerator(
@@ -9,7 +8,8 @@ ConversationalGenerator::ConversationalGenerator(
     std::vector<SpatialPooler*>* spatial_poolers,
     std::vector<ResonanceLayer*>* resonance_layers,
     std::vector<TemporalMemory*>* temporal_memories,
-    torch::Tensor& vocab_matrix, const EmotionConfig& emotion_config, torch::Device device)
+    torch::Tensor& vocab_matrix, const EmotionConfig& emotion_config, torch::Device device,
+    WeightPrecision inference_precision)
     : text_enc_(text_encoder),
       sps_(spatial_poolers),
       rls_(resonance_layers),
@@ -17,11 +17,24 @@ ConversationalGenerator::ConversationalGenerator(
       vocab_matrix_(vocab_matrix),
       emotion_config_(emotion_config),
       device_(device),
-      coordinates_({0.0, 0.0}) {
+      coordinates_({0.0, 0.0}),
+      sampler_(static_cast<int>(vocab_matrix.size(0)), emotion_config),
+      host_logits_(torch::empty({vocab_matrix.size(0)}, torch::TensorOptions().dtype(torch::kFloat32))) {
+
+    piece_text_.reserve(text_enc_->getVocabSize());
+    for (int id = 0; id < text_enc_->getVocabSize(); ++id) {
+        piece_text_.push_back(text_enc_->pieceText(id));
+    }
     
     const int position_sdr_size = 2048;
     grid_encoder_ = GridCellEncoder(position_sdr_size, static_cast<int>(position_sdr_size * 0.02));
     grid_encoder_.addModule(50.0, 101);
+
+    if (device_.is_cpu()) {
+        engine_ = std::make_unique<InferenceEngine>(*text_enc_, grid_encoder_, *(*sps_)[0], *(*rls_)[0],
+                                                    *(*tms_)[0], vocab_matrix_, inference_precision);
+        workspace_ = engine_->createWorkspace();
+    }
 }
 
 void ConversationalGenerator::startNewConversation() {
@@ -29,99 +42,135 @@ void ConversationalGenerator::startNewConversation() {
         tm->resetStates();
     }
     coordinates_ = {0.0, 0.0};
+    if (engine_) engine_->reset(workspace_);
+    sampler_.clearHistory();
     std::cout << "New conversation started." << std::endl;
 }
 
 void ConversationalGenerator::feedInput(int token_id) {
-    SDR token_sdr = text_enc_->encodeSingleToken(token_id);
+    if (engine_) {
+        engine_->feed(token_id, workspace_);
+        return;
+    }
     coordinates_[0] += 1.0;
     coordinates_[1] += 1.0;
-    SDR position_sdr = grid_encoder_.encode(coordinates_);
-    SDR concatenated_sdr = token_sdr;
-    concatenated_sdr.insert(concatenated_sdr.end(), position_sdr.begin(), position_sdr.end());
+    SparseSdr position_sdr = grid_encoder_.encodeSparse(coordinates_);
+    ConcatenatedSdr input_sdr;
+    input_sdr.append(text_enc_->encodeSingleTokenSparse(token_id));
+    input_sdr.append(position_sdr);
 
     SpatialPooler& sp = *(*sps_)[0];
     ResonanceLayer& rl = *(*rls_)[0];
     TemporalMemory& tm = *(*tms_)[0];
 
-    SDR basis_sdr = sp.process(concatenated_sdr, false);
+    SparseSdr basis_sdr = sp.process(input_sdr, false);
     torch::Tensor rdr = rl.process(basis_sdr);
     tm.process(rdr);
 }
 
+// Same result as calling feedInput for each token (up to summation order), as a prefill:
+// the prompt is encoded and pooled as one batch, the RL runs as one batched gather, and the
+// TemporalMemory's input projection is one GEMM ahead of the recurrent scan. Only the final
+// state is kept for decoding.
+void ConversationalGenerator::feedPrompt(const std::vector<int>& token_ids) {
+    if (engine_) {
+        engine_->prefill(token_ids, workspace_);
+        return;
+    }
+
+    SpatialPooler& sp = *(*sps_)[0];
+    ResonanceLayer& rl = *(*rls_)[0];
+    TemporalMemory& tm = *(*tms_)[0];
+
+    std::vector<SparseSdr> position_sdrs(token_ids.size());
+    std::vector<ConcatenatedSdr> input_sdrs(token_ids.size());
+    for (size_t t = 0; t < token_ids.size(); ++t) {
+        coordinates_[0] += 1.0;
+        coordinates_[1] += 1.0;
+        grid_encoder_.encodeSparse(coordinates_, position_sdrs[t]);
+        input_sdrs[t].append(text_enc_->encodeSingleTokenSparse(token_ids[t]));
+        input_sdrs[t].append(position_sdrs[t]);
+    }
+    tm.processSequence(rl.processBatch(sp.inferBatch(input_sdrs)));
+}
+
 torch::Tensor ConversationalGenerator::getPrediction() {
     return (*tms_)[0]->getPredictiveState();
 }
 
+namespace {
+
+// Length of the longest prefix of `text` that does not end inside a UTF-8 sequence, so a
+// character split across byte-fallback tokens is only streamed once it is whole.
+size_t completeUtf8Length(const std::string& text) {
+    const size_t n = text.size();
+    for (size_t back = 1; back <= 4 && back <= n; ++back) {
+        const unsigned char c = static_cast<unsigned char>(text[n - back]);
+        if ((c & 0xC0) == 0x80) continue; // Continuation byte
+        const size_t needed = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 1;
+        return back >= needed ? n : n - back;
+    }
+    return n;
+}
+
+} // namespace
+
 std::string ConversationalGenerator::respondTo(const std::string& prompt_text, int max_new_tokens) {
+    return respondTo(prompt_text, max_new_tokens, TextCallback());
+}
+
+std::string ConversationalGenerator::respondTo(const std::string& prompt_text, int max_new_tokens,
+                                               const TextCallback& on_text) {
     torch::NoGradGuard no_grad;
     
     std::vector<int> prompt_token_ids = text_enc_->tokenize(prompt_text);
     if (!prompt_token_ids.empty()) {
-        for(const auto& token_id : prompt_token_ids) {
-            feedInput(token_id);
-        }
+        feedPrompt(prompt_token_ids);
     }
 
-    std::vector<int> generated_ids;
+    const std::vector<int> first_token_bans = {text_enc_->getUnkId(), 2, 3};
+    const std::vector<int> no_bans;
+    std::string response;
+    size_t streamed = 0;
     for (int i = 0; i < max_new_tokens; ++i) {
-        torch::Tensor prediction_tensor = getPrediction();
-        int next_token_id;
-
-        if (i == 0) {
-            next_token_id = decodePrediction(prediction_tensor, {text_enc_->getUnkId(), 2, 3});
-        } else {
-            next_token_id = decodePrediction(prediction_tensor);
-        }
+        int next_token_id = nextToken(i == 0 ? first_token_bans : no_bans);
 
         if (next_token_id == text_enc_->getUnkId() || next_token_id >= text_enc_->getVocabSize() || next_token_id == 2) {
             break;
         }
-        generated_ids.push_back(next_token_id);
+        sampler_.record(next_token_id);
         feedInput(next_token_id);
-    }
 
-    std::string response = text_enc_->decode(generated_ids);
-    const std::string sp_space = "\xE2\x96\x81";
-    size_t pos = 0;
-    while ((pos = response.find(sp_space, pos)) != std::string::npos) {
-        response.replace(pos, sp_space.length(), " ");
-    }
-    if (!response.empty() && response.front() == ' ') {
-        response = response.substr(1);
+        // Detokenize incrementally; the response's leading space is dropped (also when the
+        // first pieces decode to nothing).
+        const std::string& piece = piece_text_[next_token_id];
+        response.append(piece, (response.empty() && !piece.empty() && piece.front() == ' ') ? 1 : 0, std::string::npos);
+        const size_t complete = completeUtf8Length(response);
+        if (on_text && complete > streamed) {
+            const bool keep_going = on_text(response.substr(streamed, complete - streamed));
+            streamed = complete;
+            if (!keep_going) break;
+        }
     }
+    // A character left incomplete when generation stopped is dropped, not emitted half-written.
+    response.resize(completeUtf8Length(response));
+    if (on_text && streamed < response.size()) on_text(response.substr(streamed));
     return response;
 }
 
+int ConversationalGenerator::nextToken(const std::vector<int>& banned_tokens) {
+    if (engine_) {
+        int next_token_id = sampler_.sample(engine_->computeLogits(workspace_).data(), banned_tokens);
+        return next_token_id < 0 ? text_enc_->getUnkId() : next_token_id;
+    }
+    return decodePrediction(getPrediction(), banned_tokens);
+}
+
 int ConversationalGenerator::decodePrediction(const torch::Tensor& prediction_tensor, const std::vector<int>& banned_tokens) {
     torch::Tensor logits = torch::matmul(vocab_matrix_, prediction_tensor).squeeze();
     logits = torch::clamp(logits, -15.0f, 15.0f);
+    host_logits_.copy_(logits);
 
-    for (const auto& token_id : banned_tokens) {
-        if (token_id >= 0 && token_id < logits.size(0)) {
-            logits[token_id] = -std::numeric_limits<float>::infinity();
-        }
-    }
-
-    // [SLLM FIX] Replace the fragile top_k logic with a robust `masked_fill_` implementation.
-    if (emotion_config_.top_k > 0 && emotion_config_.top_k < logits.size(0)) {
-        // Find the value of the k-th largest logit.
-        auto k_th_value = std::get<0>(torch::topk(logits, emotion_config_.top_k))[-1];
-        // Create a mask where logits are less than this threshold.
-        auto mask = logits < k_th_value;
-        // Set all values that are True in the mask to -infinity (in-place).
-        logits.masked_fill_(mask, -std::numeric_limits<float>::infinity());
-    }
-
-    logits /= emotion_config_.temp;
-    auto probs = torch::softmax(logits, 0);
-
-    if (torch::any(torch::isnan(probs)).item<bool>()) {
-        // This block should no longer be reachable, but is kept as a safeguard.
-        return text_enc_->getUnkId();
-    }
-
-    int next_token_id = torch::multinomial(probs, 1).item<int>();
-    
-    return next_token_id;
-}
\ No newline at end of file
+    int next_token_id = sampler_.sample(host_logits_.data_ptr<float>(), banned_tokens);
+    return next_token_id < 0 ? text_enc_->getUnkId() : next_token_id;
+}
@@ -8,9 +8,13 @@
 #include "resonance_layer.hpp"
 #include "grid_cell_encoder.hpp"
 #include "emotion.hpp"
+#include "inference_engine.hpp"
+#include "token_sampler.hpp"
 #include <torch/torch.h>
 #include <string>
 #include <vector>
+#include <memory>
+#include <functional>
 
 class ConversationalGenerator {
 public:
@@ -21,17 +25,30 @@ public:
         std::vector<TemporalMemory*>* temporal_memories,
         torch::Tensor& vocab_matrix,
         const EmotionConfig& emotion_config,
-        torch::Device device
+        torch::Device device,
+        WeightPrecision inference_precision = WeightPrecision::Float32
     );
 
+    // Receives each new piece of response text as soon as its token is sampled; returning
+    // false stops generation early, and the callback is not called again.
+    using TextCallback = std::function<bool(const std::string& text)>;
+
     std::string respondTo(const std::string& prompt_text, int max_new_tokens = 50);
+    // Streaming form: `on_text` sees the response incrementally (whole UTF-8 characters only;
+    // a character still incomplete when generation stops is dropped), and the concatenation of
+    // what it sees is the returned string.
+    std::string respondTo(const std::string& prompt_text, int max_new_tokens, const TextCallback& on_text);
     void startNewConversation();
 
 private:
     void feedInput(int token_id);
+    void feedPrompt(const std::vector<int>& token_ids);
     torch::Tensor getPrediction();
+    // Samples the next token, through the InferenceEngine on CPU or decodePrediction otherwise.
+    int nextToken(const std::vector<int>& banned_tokens);
     
     // [SLLM MODIFIED] The signature is updated to allow for banning specific tokens during generation.
+    // Logits are computed on the device and copied to the host once for the TokenSampler.
     int decodePrediction(const torch::Tensor& prediction_tensor, const std::vector<int>& banned_tokens = {});
 
     TextSdrEncoder* text_enc_;
@@ -45,6 +62,15 @@ private:
     torch::Tensor& vocab_matrix_;
     EmotionConfig emotion_config_;
     torch::Device device_;
+
+    // CPU generation runs through the engine; its workspace holds the session state.
+    std::unique_ptr<InferenceEngine> engine_;
+    InferenceEngine::Workspace workspace_;
+
+    // Top-k / temperature / repetition-penalty sampling; its window spans the conversation.
+    TokenSampler sampler_;
+    torch::Tensor host_logits_; // decodePrediction's host copy
+    std::vector<std::string> piece_text_; // Per token id, its text in a decoded string
 };
 
 #endif // CONVERSATIONAL_GENERATOR_HPP
\ No newline at end of file
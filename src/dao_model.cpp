@@ -1,21 +1,58 @@
 // src/dao_model.cpp
 #include "dao_model.hpp"
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+#include "cereal/types/Eigen.hpp"
 #include <iostream>
 #include <filesystem>
+#include <sstream>
 #include <stdexcept>
 
+namespace {
+
+torch::Tensor spatialPoolerToTensor(const SpatialPooler& sp) {
+    std::ostringstream os;
+    {
+        cereal::BinaryOutputArchive archive(os);
+        archive(sp);
+    }
+    const std::string bytes = os.str();
+    return torch::from_blob(const_cast<char*>(bytes.data()), {static_cast<int64_t>(bytes.size())},
+                            torch::TensorOptions().dtype(torch::kUInt8)).clone();
+}
+
+void spatialPoolerFromTensor(const torch::Tensor& tensor, SpatialPooler& sp) {
+    torch::Tensor bytes = tensor.to(torch::kCPU).contiguous();
+    std::istringstream is(std::string(reinterpret_cast<const char*>(bytes.data_ptr<uint8_t>()),
+                                      static_cast<size_t>(bytes.numel())));
+    cereal::BinaryInputArchive archive(is);
+    archive(sp);
+}
+
+} // namespace
+
+std::vector<std::pair<std::string, torch::Tensor>> DaoModel::namedTensors() const {
+    std::vector<std::pair<std::string, torch::Tensor>> tensors;
+    if (!spatial_poolers.empty()) {
+        tensors.emplace_back("spatial_pooler_0", spatialPoolerToTensor(spatial_poolers[0]));
+    }
+    if (!resonance_layers.empty()) {
+        tensors.emplace_back("resonance_weights_0", resonance_layers[0].getWeights());
+    }
+    if (!temporal_memories.empty()) {
+        auto tm_tensors = temporal_memories[0].namedTensors();
+        tensors.insert(tensors.end(), tm_tensors.begin(), tm_tensors.end());
+    }
+    tensors.emplace_back("vocab_matrix", vocab_matrix);
+    return tensors;
+}
+
 void DaoModel::save(const std::string& path) {
     try {
         torch::serialize::OutputArchive archive;
-        
-        if (!resonance_layers.empty()) {
-            archive.write("resonance_weights_0", this->resonance_layers[0].getWeights().to(torch::kCPU));
-        }
-        if (!temporal_memories.empty()) {
-            this->temporal_memories[0].save(archive);
+        for (const auto& named : namedTensors()) {
+            archive.write(named.first, named.second.to(torch::kCPU));
         }
-        archive.write("vocab_matrix", this->vocab_matrix.to(torch::kCPU));
-
         archive.save_to(path);
         std::cout << "Model saved to " << path << std::endl;
     } catch (const c10::Error& e) {
@@ -30,24 +67,32 @@ void DaoModel::load(const std::string& path, torch::Device device) {
     try {
         torch::serialize::InputArchive archive;
         archive.load_from(path);
-
-        // [SLLM FIX] Correctly load weights into existing layers.
-        // The calling function is responsible for creating the layers first.
-        if (this->resonance_layers.empty() || this->temporal_memories.empty()) {
-             throw std::runtime_error("Model layers must be constructed before loading state.");
-        }
-        
-        torch::Tensor resonance_weights;
-        archive.read("resonance_weights_0", resonance_weights);
-        this->resonance_layers[0].getWeights() = resonance_weights.to(device);
-        
-        this->temporal_memories[0].load(archive, device);
-        
-        archive.read("vocab_matrix", this->vocab_matrix);
-        this->vocab_matrix = this->vocab_matrix.to(device).requires_grad_(true);
-
+        load(archive, device);
         std::cout << "Model loaded from " << path << " and moved to " << device << std::endl;
     } catch (const c10::Error& e) {
         std::cerr << "Error loading model: " << e.what() << std::endl;
     }
-}
\ No newline at end of file
+}
+
+void DaoModel::load(torch::serialize::InputArchive& archive, torch::Device device) {
+    // [SLLM FIX] Correctly load weights into existing layers.
+    // The calling function is responsible for creating the layers first.
+    if (this->resonance_layers.empty() || this->temporal_memories.empty()) {
+         throw std::runtime_error("Model layers must be constructed before loading state.");
+    }
+
+    // Models saved before the pooler was stored keep the freshly constructed one.
+    torch::Tensor spatial_pooler_bytes;
+    if (!this->spatial_poolers.empty() && archive.try_read("spatial_pooler_0", spatial_pooler_bytes)) {
+        spatialPoolerFromTensor(spatial_pooler_bytes, this->spatial_poolers[0]);
+    }
+
+    torch::Tensor resonance_weights;
+    archive.read("resonance_weights_0", resonance_weights);
+    this->resonance_layers[0].getWeights() = resonance_weights.to(device).requires_grad_(true);
+
+    this->temporal_memories[0].load(archive, device);
+
+    archive.read("vocab_matrix", this->vocab_matrix);
+    this->vocab_matrix = this->vocab_matrix.to(device).requires_grad_(true);
+}
@@ -5,6 +5,7 @@
 #include <torch/torch.h>
 #include <vector>
 #include <string>
+#include <utility>
 
 // [SLLM] Full definitions are now included here to give the model ownership
 // and to facilitate easier serialization of the entire model state.
@@ -22,6 +23,13 @@ struct DaoModel {
     // Member function declarations
     void save(const std::string& path);
     void load(const std::string& path, torch::Device device);
+    // Reads the model entries of an already opened archive (model or training checkpoint).
+    void load(torch::serialize::InputArchive& archive, torch::Device device);
+
+    // Everything save() writes, keyed as in the archive and still on the model's device.
+    // The SpatialPooler (randomly initialized, so part of the model) is a uint8 tensor of
+    // its cereal bytes.
+    std::vector<std::pair<std::string, torch::Tensor>> namedTensors() const;
 };
 
 #endif // DAO_MODEL_HPP
\ No newline at end of file
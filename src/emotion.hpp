@@ -11,6 +11,8 @@ struct EmotionConfig {
     // Higher values discourage repetition more strongly.
     float repetition_penalty = 1.2f;
     int repetition_lookback = 30; // How many recent tokens to consider for the penalty.
+    // Sampler seed; -1 draws a random one per generator. Fix it for reproducible runs.
+    long long seed = -1;
 
     // --- FINAL SYNTHESIS: A model of Stillness and Harmony ---
     float global_weight = 0.0073f;
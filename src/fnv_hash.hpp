@@ -0,0 +1,41 @@
+// src/fnv_hash.hpp
+#ifndef FNV_HASH_HPP
+#define FNV_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Incremental 64-bit FNV-1a hash.
+ *
+ * Used to fingerprint model and encoder state, so on-disk caches derived from that
+ * state can tell when they are stale. Not a cryptographic hash.
+ */
+class Fnv1a64 {
+public:
+    void update(const void* data, std::size_t bytes) {
+        const auto* p = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < bytes; ++i) {
+            hash_ = (hash_ ^ p[i]) * 1099511628211ull;
+        }
+    }
+
+    template <typename T>
+    void updateValue(const T& value) {
+        update(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void updateVector(const std::vector<T>& values) {
+        updateValue(static_cast<uint64_t>(values.size()));
+        update(values.data(), values.size() * sizeof(T));
+    }
+
+    uint64_t digest() const { return hash_; }
+
+private:
+    uint64_t hash_ = 14695981039346656037ull;
+};
+
+#endif // FNV_HASH_HPP
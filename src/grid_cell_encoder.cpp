@@ -1,6 +1,8 @@
 // src/grid_cell_encoder.cpp
 #include "grid_cell_encoder.hpp"
+#include "fnv_hash.hpp"
 #include <stdexcept>
+#include <algorithm>
 
 GridCellEncoder::GridCellEncoder(int sdr_size, int sdr_active_bits)
     : sdr_size_(sdr_size), sdr_active_bits_(sdr_active_bits) {
@@ -18,22 +20,63 @@ void GridCellEncoder::addModule(double resolution, int seed) {
 }
 
 SDR GridCellEncoder::encode(const std::vector<double>& coordinates) {
+    return encodePacked(coordinates).toDense();
+}
+
+PackedSdr GridCellEncoder::encodePacked(const std::vector<double>& coordinates) {
     if (coordinates.size() != 2) {
         throw std::invalid_argument("Coordinates must be a 2D vector [x, y].");
     }
 
-    SDR composite_sdr(sdr_size_, 0);
+    PackedSdr composite_sdr(sdr_size_);
+    std::vector<int> active_indices;
+    active_indices.reserve(sdr_active_bits_);
 
     for (const auto& module : modules_) {
-        // Encode the x and y coordinates separately
-        SDR sdr_x = encode_scalar(module.x_rdse, coordinates[0]);
-        SDR sdr_y = encode_scalar(module.y_rdse, coordinates[1]);
-
-        // Combine the module's SDRs with the composite SDR using a bitwise OR
-        for (int i = 0; i < sdr_size_; ++i) {
-            composite_sdr[i] = composite_sdr[i] | sdr_x[i] | sdr_y[i];
-        }
+        // Encode the x and y coordinates separately and OR their bits into the composite
+        encode_scalar_indices(module.x_rdse, coordinates[0], active_indices);
+        for (int idx : active_indices) composite_sdr.set(idx);
+        encode_scalar_indices(module.y_rdse, coordinates[1], active_indices);
+        for (int idx : active_indices) composite_sdr.set(idx);
     }
 
     return composite_sdr;
-}
\ No newline at end of file
+}
+
+SparseSdr GridCellEncoder::encodeSparse(const std::vector<double>& coordinates) const {
+    SparseSdr sdr;
+    encodeSparse(coordinates, sdr);
+    return sdr;
+}
+
+void GridCellEncoder::encodeSparse(const std::vector<double>& coordinates, SparseSdr& out) const {
+    if (coordinates.size() != 2) {
+        throw std::invalid_argument("Coordinates must be a 2D vector [x, y].");
+    }
+
+    out.size = sdr_size_;
+    out.active.clear();
+    for (const auto& module : modules_) {
+        append_scalar_indices(module.x_rdse, coordinates[0], out.active);
+        append_scalar_indices(module.y_rdse, coordinates[1], out.active);
+    }
+
+    // The OR of the modules' bits: sort and drop bits that several encoders share.
+    std::sort(out.active.begin(), out.active.end());
+    out.active.erase(std::unique(out.active.begin(), out.active.end()), out.active.end());
+}
+
+uint64_t GridCellEncoder::configHash() const {
+    Fnv1a64 hash;
+    hash.updateValue(sdr_size_);
+    hash.updateValue(sdr_active_bits_);
+    for (const auto& module : modules_) {
+        for (const RDSEInstance* rdse : {&module.x_rdse, &module.y_rdse}) {
+            hash.updateValue(rdse->size);
+            hash.updateValue(rdse->active_bits);
+            hash.updateValue(rdse->resolution);
+            hash.updateVector(rdse->prototypes);
+        }
+    }
+    return hash.digest();
+}
@@ -3,6 +3,8 @@
 #define GRID_CELL_ENCODER_HPP
 
 #include "rdse.hpp"
+#include "packed_sdr.hpp"
+#include "sparse_sdr.hpp"
 #include <vector>
 #include <cereal/cereal.hpp>
 #include <cereal/types/vector.hpp>
@@ -20,6 +22,14 @@ public:
 
     void addModule(double resolution, int seed);
     SDR encode(const std::vector<double>& coordinates);
+    // Same encoding, returned as a packed bit set
+    PackedSdr encodePacked(const std::vector<double>& coordinates);
+    // Same encoding as sorted active indices; the out-parameter form reuses its storage
+    SparseSdr encodeSparse(const std::vector<double>& coordinates) const;
+    void encodeSparse(const std::vector<double>& coordinates, SparseSdr& out) const;
+    int getSdrSize() const { return sdr_size_; }
+    // Fingerprint of the encoder configuration (sizes and every module's prototypes).
+    uint64_t configHash() const;
 
 private:
     friend class cereal::access;
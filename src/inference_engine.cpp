@@ -0,0 +1,170 @@
+// src/inference_engine.cpp
+#include "inference_engine.hpp"
+#include <stdexcept>
+
+namespace {
+
+torch::Tensor toCpuFloat(const torch::Tensor& tensor) {
+    return tensor.detach().to(torch::kCPU, torch::kFloat32).contiguous();
+}
+
+Eigen::Map<const MatrixXf> asRowMajor(const torch::Tensor& tensor) {
+    return Eigen::Map<const MatrixXf>(tensor.data_ptr<float>(), tensor.size(0), tensor.size(1));
+}
+
+} // namespace
+
+InferenceEngine::InferenceEngine(const TextSdrEncoder& text_encoder, const GridCellEncoder& position_encoder,
+                                 SpatialPooler& spatial_pooler, const ResonanceLayer& resonance_layer,
+                                 const TemporalMemory& temporal_memory, const torch::Tensor& vocab_matrix,
+                                 WeightPrecision precision)
+    : text_encoder_(&text_encoder),
+      position_encoder_(position_encoder),
+      spatial_pooler_(&spatial_pooler) {
+
+    torch::NoGradGuard no_grad;
+    torch::Tensor resonance = toCpuFloat(resonance_layer.getWeights());
+    torch::Tensor input_weights = toCpuFloat(temporal_memory.getInputWeights());
+    torch::Tensor bias = toCpuFloat(temporal_memory.getBias());
+    torch::Tensor vocab = toCpuFloat(vocab_matrix);
+
+    const int64_t cells = bias.numel();
+    if (input_weights.size(0) != cells || input_weights.size(1) != resonance.size(0) ||
+        resonance.size(1) != spatial_pooler.getNumColumns() || vocab.size(1) != cells) {
+        throw std::invalid_argument("Model weights have inconsistent shapes for InferenceEngine.");
+    }
+
+    // Fold the resonance layer into the TM input projection once, so a token's input
+    // term becomes a gather of the columns of the active SP columns.
+    torch::Tensor fused = torch::matmul(input_weights, resonance).t().contiguous();
+    input_by_basis_ = QuantizedMatrix(asRowMajor(fused), precision);
+    recurrent_structure_ = temporal_memory.getRecurrentStructure();
+    switch (recurrent_structure_) {
+        case TemporalMemory::RecurrentStructure::Dense:
+            recurrent_ = QuantizedMatrix(asRowMajor(toCpuFloat(temporal_memory.getRecurrentWeights())), precision);
+            break;
+        case TemporalMemory::RecurrentStructure::LowRank:
+            recurrent_ = QuantizedMatrix(asRowMajor(toCpuFloat(temporal_memory.getRecurrentU())), precision);
+            recurrent_v_t_ = QuantizedMatrix(asRowMajor(toCpuFloat(temporal_memory.getRecurrentV().t())), precision);
+            break;
+        case TemporalMemory::RecurrentStructure::BlockDiagonal: {
+            torch::Tensor blocks = toCpuFloat(temporal_memory.getRecurrentWeights());
+            recurrent_ = QuantizedMatrix(asRowMajor(blocks.reshape({cells, blocks.size(2)})), precision);
+            break;
+        }
+    }
+    bias_ = Eigen::Map<const VectorXf>(bias.data_ptr<float>(), cells);
+    vocab_ = QuantizedMatrix(asRowMajor(vocab), precision);
+}
+
+InferenceEngine::Workspace InferenceEngine::createWorkspace() const {
+    Workspace workspace;
+    workspace.coordinates = {0.0, 0.0};
+    workspace.position_sdr.active.reserve(position_encoder_.getSdrSize());
+    workspace.basis_sdr.active.reserve(spatial_pooler_->getNumColumns());
+    // Touch the input view once so its part list has capacity before the first token.
+    workspace.input_sdr.append(workspace.position_sdr);
+    workspace.input_sdr.append(workspace.position_sdr);
+    workspace.input_sdr.clear();
+    workspace.hidden = VectorXf::Zero(getNumCells());
+    workspace.next_hidden = VectorXf::Zero(getNumCells());
+    workspace.low_rank = VectorXf::Zero(recurrent_v_t_.rows());
+    workspace.logits = VectorXf::Zero(getVocabSize());
+    return workspace;
+}
+
+void InferenceEngine::reset(Workspace& workspace, double last_position) const {
+    workspace.coordinates[0] = last_position;
+    workspace.coordinates[1] = last_position;
+    workspace.hidden.setZero();
+}
+
+void InferenceEngine::recurrentProduct(Workspace& workspace) const {
+    switch (recurrent_structure_) {
+        case TemporalMemory::RecurrentStructure::Dense:
+            recurrent_.multiply(workspace.hidden.data(), workspace.next_hidden.data());
+            break;
+        case TemporalMemory::RecurrentStructure::LowRank:
+            recurrent_v_t_.multiply(workspace.hidden.data(), workspace.low_rank.data());
+            recurrent_.multiply(workspace.low_rank.data(), workspace.next_hidden.data());
+            break;
+        case TemporalMemory::RecurrentStructure::BlockDiagonal:
+            recurrent_.multiplyBlockDiagonal(workspace.hidden.data(), workspace.next_hidden.data());
+            break;
+    }
+}
+
+void InferenceEngine::finishStep(Workspace& workspace) {
+    workspace.next_hidden.array() = workspace.next_hidden.array().tanh();
+    workspace.hidden.swap(workspace.next_hidden);
+}
+
+void InferenceEngine::feed(int token_id, Workspace& workspace) {
+    workspace.coordinates[0] += 1.0;
+    workspace.coordinates[1] += 1.0;
+    position_encoder_.encodeSparse(workspace.coordinates, workspace.position_sdr);
+    workspace.input_sdr.clear();
+    workspace.input_sdr.append(text_encoder_->encodeSingleTokenSparse(token_id));
+    workspace.input_sdr.append(workspace.position_sdr);
+    spatial_pooler_->process(workspace.input_sdr, false, workspace.basis_sdr);
+
+    // h' = tanh(W_rec * h + b + sum over active columns c of (W_in * RL)[:, c])
+    recurrentProduct(workspace);
+    workspace.next_hidden += bias_;
+    for (int column : workspace.basis_sdr.active) {
+        input_by_basis_.addRow(column, workspace.next_hidden.data());
+    }
+    finishStep(workspace);
+}
+
+void InferenceEngine::prefill(const std::vector<int>& token_ids, Workspace& workspace) {
+    const int steps = static_cast<int>(token_ids.size());
+    if (steps == 0) return;
+    workspace.prompt_positions.resize(steps);
+    workspace.prompt_inputs.resize(steps);
+    if (workspace.prompt_projection.cols() < steps) {
+        workspace.prompt_projection.resize(getNumCells(), steps);
+    }
+
+    // Encode every (token, position) pair and pool them as one batch.
+    const double first_position = workspace.coordinates[0] + 1.0;
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < steps; ++t) {
+        const std::vector<double> coordinates(2, first_position + t);
+        position_encoder_.encodeSparse(coordinates, workspace.prompt_positions[t]);
+        ConcatenatedSdr& input = workspace.prompt_inputs[t];
+        input.clear();
+        input.append(text_encoder_->encodeSingleTokenSparse(token_ids[t]));
+        input.append(workspace.prompt_positions[t]);
+    }
+    const std::vector<SparseSdr> basis_sdrs = spatial_pooler_->inferBatch(workspace.prompt_inputs);
+
+    // Column t: b + sum over token t's active columns of (W_in * RL)[:, c].
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < steps; ++t) {
+        float* column = workspace.prompt_projection.col(t).data();
+        Eigen::Map<VectorXf>(column, getNumCells()) = bias_;
+        for (int basis_column : basis_sdrs[t].active) {
+            input_by_basis_.addRow(basis_column, column);
+        }
+    }
+
+    // The recurrence itself is sequential: one GEMV per token.
+    for (int t = 0; t < steps; ++t) {
+        recurrentProduct(workspace);
+        workspace.next_hidden += workspace.prompt_projection.col(t);
+        finishStep(workspace);
+    }
+    workspace.coordinates[0] += steps;
+    workspace.coordinates[1] += steps;
+}
+
+const VectorXf& InferenceEngine::computeLogits(Workspace& workspace) const {
+    vocab_.multiply(workspace.hidden.data(), workspace.logits.data());
+    workspace.logits.array() = workspace.logits.array().max(-15.0f).min(15.0f);
+    return workspace.logits;
+}
+
+std::size_t InferenceEngine::getWeightBytes() const {
+    return input_by_basis_.byteSize() + recurrent_.byteSize() + recurrent_v_t_.byteSize() + vocab_.byteSize();
+}
@@ -0,0 +1,97 @@
+// src/inference_engine.hpp
+#ifndef INFERENCE_ENGINE_HPP
+#define INFERENCE_ENGINE_HPP
+
+#include "types.hpp"
+#include "sparse_sdr.hpp"
+#include "text_sdr_encoder.hpp"
+#include "grid_cell_encoder.hpp"
+#include "spatial_pooler.hpp"
+#include "resonance_layer.hpp"
+#include "temporal_memory.hpp"
+#include "quantized_matrix.hpp"
+#include <torch/torch.h>
+#include <vector>
+
+/**
+ * @brief CPU token step for generation: encode -> SP -> RL -> TM -> logits (sampled by TokenSampler).
+ *
+ * The engine snapshots the model weights into plain buffers when it is built and
+ * runs each stage as a kernel over raw memory, so a token step goes through no libtorch
+ * dispatch at all. Everything a step writes lives in a Workspace that is sized once per
+ * session; after the first token nothing is allocated.
+ *
+ * The RL and the TM input projection are folded into one matrix at construction
+ * (W_in * RL, stored transposed), so the input term of the recurrence is the sum of the
+ * ~10 columns picked by the active SP columns and only the recurrent GEMV and the
+ * vocab GEMV touch a full matrix per token.
+ *
+ * The three matrices can be stored as bf16 or per-row int8 (see QuantizedMatrix) to
+ * shrink the per-token weight stream; the bias and the SP stay in full precision.
+ * Weights are copied, so the engine must be rebuilt if the model is trained further.
+ */
+class InferenceEngine {
+public:
+    // Per-session state and scratch. Create with createWorkspace(); not shared between threads.
+    struct Workspace {
+        std::vector<double> coordinates;
+        SparseSdr position_sdr;
+        ConcatenatedSdr input_sdr;
+        SparseSdr basis_sdr;
+        VectorXf hidden;
+        VectorXf next_hidden;
+        VectorXf low_rank; // V^T * h for a LowRank recurrence
+        VectorXf logits;
+        // prefill() scratch, sized to the last prompt (the projection to the longest one).
+        std::vector<SparseSdr> prompt_positions;
+        std::vector<ConcatenatedSdr> prompt_inputs;
+        Eigen::MatrixXf prompt_projection; // [cells, T], column-major: bias + the folded input term of each token
+    };
+
+    InferenceEngine(const TextSdrEncoder& text_encoder, const GridCellEncoder& position_encoder,
+                    SpatialPooler& spatial_pooler, const ResonanceLayer& resonance_layer,
+                    const TemporalMemory& temporal_memory, const torch::Tensor& vocab_matrix,
+                    WeightPrecision precision = WeightPrecision::Float32);
+
+    Workspace createWorkspace() const;
+    // Zeroes the hidden state, like TemporalMemory::resetStates. The next feed() is encoded
+    // at position `last_position + 1`.
+    void reset(Workspace& workspace, double last_position = 0.0) const;
+
+    // Advances the position by one and feeds `token_id`; same result as the torch pipeline.
+    void feed(int token_id, Workspace& workspace);
+    // Feeds a whole prompt; same state as feed() per token (up to summation order). The
+    // encoding, the SP and the input term of every token are computed up front, in parallel
+    // across tokens, leaving only the recurrent GEMV per token in the sequential scan.
+    void prefill(const std::vector<int>& token_ids, Workspace& workspace);
+
+    // vocab * hidden, clamped to [-15, 15]; valid until the next call on this workspace.
+    const VectorXf& computeLogits(Workspace& workspace) const;
+
+    int getVocabSize() const { return vocab_.rows(); }
+    int getNumCells() const { return static_cast<int>(bias_.size()); }
+    WeightPrecision getPrecision() const { return recurrent_.precision(); }
+    // Bytes held by the weight matrices.
+    std::size_t getWeightBytes() const;
+
+private:
+    // next_hidden = W_rec * hidden, in whichever recurrent structure the TM uses.
+    void recurrentProduct(Workspace& workspace) const;
+    // hidden = tanh(next_hidden), by swapping the two buffers.
+    static void finishStep(Workspace& workspace);
+
+    const TextSdrEncoder* text_encoder_;
+    GridCellEncoder position_encoder_;
+    SpatialPooler* spatial_pooler_;
+
+    QuantizedMatrix input_by_basis_; // [basis, cells], row c = (W_in * RL)[:, c]
+    // Dense: [cells, cells]; LowRank: U [cells, rank]; BlockDiagonal: the blocks
+    // stacked as [cells, block_size].
+    TemporalMemory::RecurrentStructure recurrent_structure_;
+    QuantizedMatrix recurrent_;
+    QuantizedMatrix recurrent_v_t_;  // LowRank only: V^T [rank, cells]
+    VectorXf bias_;                  // [cells]
+    QuantizedMatrix vocab_;          // [vocab, cells]
+};
+
+#endif // INFERENCE_ENGINE_HPP
@@ -0,0 +1,98 @@
+// src/packed_sdr.cpp
+#include "packed_sdr.hpp"
+#include <algorithm>
+
+// The baseline x86-64 ISA has no POPCNT, so without -march=native __builtin_popcountll is a
+// libgcc call per word. The popcount loops are compiled twice instead, and the dynamic
+// loader picks the POPCNT clone on CPUs that have it (GNU ifunc, so ELF targets only).
+#if defined(__x86_64__) && defined(__ELF__) && !defined(__POPCNT__) && \
+    (defined(__clang__) ? __clang_major__ >= 14 : defined(__GNUC__) && __GNUC__ >= 6)
+#define DAO_POPCNT_CLONES __attribute__((target_clones("popcnt", "default")))
+#else
+#define DAO_POPCNT_CLONES
+#endif
+
+PackedSdr::PackedSdr(int size)
+    : size_(size), words_((size + 63) / 64, 0) {}
+
+PackedSdr PackedSdr::fromDense(const SDR& sdr) {
+    PackedSdr packed(static_cast<int>(sdr.size()));
+    for (size_t i = 0; i < sdr.size(); ++i) {
+        if (sdr[i] > 0) packed.set(static_cast<int>(i));
+    }
+    return packed;
+}
+
+PackedSdr PackedSdr::fromIndices(int size, const std::vector<int>& active_indices) {
+    PackedSdr packed(size);
+    for (int idx : active_indices) {
+        packed.set(idx);
+    }
+    return packed;
+}
+
+SDR PackedSdr::toDense() const {
+    SDR sdr(size_, 0);
+    forEachActive([&sdr](int bit) { sdr[bit] = 1; });
+    return sdr;
+}
+
+std::vector<int> PackedSdr::activeIndices() const {
+    std::vector<int> indices;
+    indices.reserve(count());
+    forEachActive([&indices](int bit) { indices.push_back(bit); });
+    return indices;
+}
+
+DAO_POPCNT_CLONES int PackedSdr::count() const {
+    int total = 0;
+    for (uint64_t word : words_) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
+
+void PackedSdr::reset() {
+    std::fill(words_.begin(), words_.end(), 0);
+}
+
+// The word loops below are plain and branch-free so the compiler can vectorize them.
+PackedSdr& PackedSdr::operator|=(const PackedSdr& other) {
+    const size_t n = std::min(words_.size(), other.words_.size());
+    for (size_t i = 0; i < n; ++i) words_[i] |= other.words_[i];
+    return *this;
+}
+
+PackedSdr& PackedSdr::operator&=(const PackedSdr& other) {
+    const size_t n = std::min(words_.size(), other.words_.size());
+    for (size_t i = 0; i < n; ++i) words_[i] &= other.words_[i];
+    for (size_t i = n; i < words_.size(); ++i) words_[i] = 0;
+    return *this;
+}
+
+PackedSdr& PackedSdr::andNot(const PackedSdr& other) {
+    const size_t n = std::min(words_.size(), other.words_.size());
+    for (size_t i = 0; i < n; ++i) words_[i] &= ~other.words_[i];
+    return *this;
+}
+
+PackedSdr operator|(PackedSdr lhs, const PackedSdr& rhs) {
+    lhs |= rhs;
+    return lhs;
+}
+
+PackedSdr operator&(PackedSdr lhs, const PackedSdr& rhs) {
+    lhs &= rhs;
+    return lhs;
+}
+
+DAO_POPCNT_CLONES int overlap(const PackedSdr& sdr1, const PackedSdr& sdr2) {
+    const auto& a = sdr1.words();
+    const auto& b = sdr2.words();
+    const size_t n = std::min(a.size(), b.size());
+    int sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += __builtin_popcountll(a[i] & b[i]);
+    }
+    return sum;
+}
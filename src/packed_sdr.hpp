@@ -0,0 +1,67 @@
+// src/packed_sdr.hpp
+#ifndef PACKED_SDR_HPP
+#define PACKED_SDR_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using SDR = std::vector<int8_t>;
+
+/**
+ * @brief A binary SDR packed 64 bits per word.
+ *
+ * Takes an eighth of the memory of the byte-per-bit `SDR` and turns overlap and
+ * set operations into word-wise popcount / bitwise kernels. Bits past `size()`
+ * in the last word are always zero.
+ */
+class PackedSdr {
+public:
+    PackedSdr() = default;
+    explicit PackedSdr(int size);
+
+    static PackedSdr fromDense(const SDR& sdr);
+    static PackedSdr fromIndices(int size, const std::vector<int>& active_indices);
+    SDR toDense() const;
+    std::vector<int> activeIndices() const;
+
+    int size() const { return size_; }
+    int count() const;
+    bool test(int bit) const { return (words_[bit >> 6] >> (bit & 63)) & 1u; }
+    void set(int bit) { words_[bit >> 6] |= uint64_t{1} << (bit & 63); }
+    void reset();
+
+    PackedSdr& operator|=(const PackedSdr& other);
+    PackedSdr& operator&=(const PackedSdr& other);
+    // Clears every bit that is set in `other` (this &= ~other).
+    PackedSdr& andNot(const PackedSdr& other);
+
+    // Calls `f(bit)` for every active bit in ascending order.
+    template <typename F>
+    void forEachActive(F&& f) const {
+        for (std::size_t w = 0; w < words_.size(); ++w) {
+            uint64_t word = words_[w];
+            while (word) {
+                f(static_cast<int>(w * 64 + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
+    const std::vector<uint64_t>& words() const { return words_; }
+
+private:
+    int size_ = 0;
+    std::vector<uint64_t> words_;
+};
+
+PackedSdr operator|(PackedSdr lhs, const PackedSdr& rhs);
+PackedSdr operator&(PackedSdr lhs, const PackedSdr& rhs);
+
+/**
+ * @brief Computes the overlap (number of shared active bits) of two packed SDRs.
+ * @return popcount(sdr1 & sdr2).
+ */
+int overlap(const PackedSdr& sdr1, const PackedSdr& sdr2);
+
+#endif // PACKED_SDR_HPP
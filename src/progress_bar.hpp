@@ -22,6 +22,7 @@ public:
     }
 
     void update(long long current_step) {
+        last_step_ = current_step;
         float progress = 0.0f;
         if (total_steps_ > 0) {
             long long display_step = std::min(current_step, total_steps_);
@@ -70,11 +71,20 @@ public:
         }
         std::cout << "] " << std::fixed << std::setprecision(1) << progress * 100.0 << "%"
                   << " (" << current_step << "/" << total_steps_ << ")"
-                  << eta_str << "  "; // Extra spaces to clear previous, longer lines
+                  << eta_str;
+        if (!postfix_.empty()) std::cout << " | " << postfix_;
+        std::cout << "  "; // Extra spaces to clear previous, longer lines
                   
         std::cout.flush();
     }
     
+    // Extra status shown after the bar (e.g. loss and throughput); redrawn immediately.
+    void setPostfix(const std::string& postfix) {
+        postfix_ = postfix;
+        last_pos_ = -1;
+        update(last_step_);
+    }
+
     void done() {
         update(total_steps_);
         std::cout << std::endl; // Finish with a newline
@@ -85,6 +95,8 @@ private:
     std::string description_;
     int bar_width_;
     int last_pos_ = -1;
+    long long last_step_ = 0;
+    std::string postfix_;
     std::chrono::steady_clock::time_point start_time_;
 };
 
@@ -0,0 +1,136 @@
+// src/quantized_matrix.cpp
+#include "quantized_matrix.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Round-to-nearest-even truncation of an fp32 to its upper 16 bits.
+uint16_t toBFloat16(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+float fromBFloat16(uint16_t value) {
+    uint32_t bits = static_cast<uint32_t>(value) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+} // namespace
+
+const char* toString(WeightPrecision precision) {
+    switch (precision) {
+        case WeightPrecision::Float32: return "fp32";
+        case WeightPrecision::BFloat16: return "bf16";
+        case WeightPrecision::Int8: return "int8";
+    }
+    return "unknown";
+}
+
+QuantizedMatrix::QuantizedMatrix(const MatrixXf& weights, WeightPrecision precision)
+    : precision_(precision),
+      rows_(static_cast<int>(weights.rows())),
+      cols_(static_cast<int>(weights.cols())) {
+
+    const std::size_t count = static_cast<std::size_t>(rows_) * cols_;
+    const float* source = weights.data();
+    switch (precision_) {
+        case WeightPrecision::Float32:
+            float_values_.assign(source, source + count);
+            break;
+        case WeightPrecision::BFloat16:
+            bf16_values_.resize(count);
+            for (std::size_t i = 0; i < count; ++i) bf16_values_[i] = toBFloat16(source[i]);
+            break;
+        case WeightPrecision::Int8:
+            int8_values_.resize(count);
+            row_scales_.resize(rows_);
+            #pragma omp parallel for schedule(static)
+            for (int r = 0; r < rows_; ++r) {
+                const float* row = source + static_cast<std::size_t>(r) * cols_;
+                float max_abs = 0.0f;
+                for (int j = 0; j < cols_; ++j) max_abs = std::max(max_abs, std::abs(row[j]));
+                const float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+                row_scales_[r] = scale;
+                int8_t* out = int8_values_.data() + static_cast<std::size_t>(r) * cols_;
+                for (int j = 0; j < cols_; ++j) {
+                    out[j] = static_cast<int8_t>(std::lround(std::clamp(row[j] / scale, -127.0f, 127.0f)));
+                }
+            }
+            break;
+    }
+}
+
+// The inner loops are plain widening multiply-adds; `omp simd` lets the compiler reorder
+// the fp32 reduction so each format vectorizes.
+float QuantizedMatrix::rowDot(int row, const float* x) const {
+    const std::size_t offset = static_cast<std::size_t>(row) * cols_;
+    float sum = 0.0f;
+    switch (precision_) {
+        case WeightPrecision::Float32: {
+            const float* w = float_values_.data() + offset;
+            #pragma omp simd reduction(+:sum)
+            for (int j = 0; j < cols_; ++j) sum += w[j] * x[j];
+            return sum;
+        }
+        case WeightPrecision::BFloat16: {
+            const uint16_t* w = bf16_values_.data() + offset;
+            #pragma omp simd reduction(+:sum)
+            for (int j = 0; j < cols_; ++j) sum += fromBFloat16(w[j]) * x[j];
+            return sum;
+        }
+        case WeightPrecision::Int8: {
+            const int8_t* w = int8_values_.data() + offset;
+            #pragma omp simd reduction(+:sum)
+            for (int j = 0; j < cols_; ++j) sum += static_cast<float>(w[j]) * x[j];
+            return sum * row_scales_[row];
+        }
+    }
+    return sum;
+}
+
+void QuantizedMatrix::multiply(const float* x, float* y) const {
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < rows_; ++r) {
+        y[r] = rowDot(r, x);
+    }
+}
+
+void QuantizedMatrix::multiplyBlockDiagonal(const float* x, float* y) const {
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < rows_; ++r) {
+        y[r] = rowDot(r, x + static_cast<std::size_t>(r / cols_) * cols_);
+    }
+}
+
+void QuantizedMatrix::addRow(int row, float* y) const {
+    const std::size_t offset = static_cast<std::size_t>(row) * cols_;
+    switch (precision_) {
+        case WeightPrecision::Float32: {
+            const float* w = float_values_.data() + offset;
+            for (int j = 0; j < cols_; ++j) y[j] += w[j];
+            break;
+        }
+        case WeightPrecision::BFloat16: {
+            const uint16_t* w = bf16_values_.data() + offset;
+            for (int j = 0; j < cols_; ++j) y[j] += fromBFloat16(w[j]);
+            break;
+        }
+        case WeightPrecision::Int8: {
+            const int8_t* w = int8_values_.data() + offset;
+            const float scale = row_scales_[row];
+            for (int j = 0; j < cols_; ++j) y[j] += static_cast<float>(w[j]) * scale;
+            break;
+        }
+    }
+}
+
+std::size_t QuantizedMatrix::byteSize() const {
+    return float_values_.size() * sizeof(float) + bf16_values_.size() * sizeof(uint16_t) +
+           int8_values_.size() * sizeof(int8_t) + row_scales_.size() * sizeof(float);
+}
@@ -0,0 +1,54 @@
+// src/quantized_matrix.hpp
+#ifndef QUANTIZED_MATRIX_HPP
+#define QUANTIZED_MATRIX_HPP
+
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Storage precision of inference-only weights.
+enum class WeightPrecision { Float32, BFloat16, Int8 };
+
+const char* toString(WeightPrecision precision);
+
+/**
+ * @brief A read-only row-major weight matrix in fp32, bf16 or int8, with GEMV kernels.
+ *
+ * Generation reads every weight once per token, so it is bound by memory bandwidth;
+ * bf16 halves the stream and int8 quarters it. Int8 is symmetric with one fp32 scale
+ * per row (max |w| / 127), so each dot product is accumulated in fp32 over the raw
+ * int8 values and scaled once at the end.
+ */
+class QuantizedMatrix {
+public:
+    QuantizedMatrix() = default;
+    QuantizedMatrix(const MatrixXf& weights, WeightPrecision precision);
+
+    // y = W * x, with the rows split across threads.
+    void multiply(const float* x, float* y) const;
+    // Block-diagonal form for a [n_blocks * cols, cols] stack of square blocks: row r belongs
+    // to block r / cols and is dotted with that block's slice of x, so x and y have rows() entries.
+    void multiplyBlockDiagonal(const float* x, float* y) const;
+    // y += W[row, :] (dequantized).
+    void addRow(int row, float* y) const;
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    WeightPrecision precision() const { return precision_; }
+    // Bytes held by the weights and scales.
+    std::size_t byteSize() const;
+
+private:
+    float rowDot(int row, const float* x) const;
+
+    WeightPrecision precision_ = WeightPrecision::Float32;
+    int rows_ = 0;
+    int cols_ = 0;
+    std::vector<float> float_values_;
+    std::vector<uint16_t> bf16_values_;
+    std::vector<int8_t> int8_values_;
+    std::vector<float> row_scales_;
+};
+
+#endif // QUANTIZED_MATRIX_HPP
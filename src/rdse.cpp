@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <stdexcept>
 
 RDSEInstance create_rdse(int n, int w, double resolution, int seed) {
     RDSEInstance instance;
@@ -24,37 +25,71 @@ RDSEInstance create_rdse(int n, int w, double resolution, int seed) {
     for (int i = 0; i < n; ++i) {
         instance.prototypes.push_back(distrib(gen));
     }
+    build_sorted_index(instance);
     
     return instance;
 }
 
-SDR encode_scalar(const RDSEInstance& rdse_instance, double value) {
-    if (rdse_instance.active_bits > rdse_instance.size) {
-        // Handle error or adjust, for now, we assume valid input
+void build_sorted_index(RDSEInstance& rdse_instance) {
+    const auto& prototypes = rdse_instance.prototypes;
+    rdse_instance.sorted_indices.resize(prototypes.size());
+    std::iota(rdse_instance.sorted_indices.begin(), rdse_instance.sorted_indices.end(), 0);
+    std::sort(rdse_instance.sorted_indices.begin(), rdse_instance.sorted_indices.end(),
+              [&prototypes](int a, int b) {
+                  return prototypes[a] < prototypes[b] || (prototypes[a] == prototypes[b] && a < b);
+              });
+}
+
+// Calls `emit(index)` for the `active_bits` prototypes nearest to `value`, nearest first.
+// Distance ties are broken towards the lower prototype index.
+template <typename Emit>
+static void for_each_nearest_prototype(const RDSEInstance& rdse_instance, double value, Emit emit) {
+    const auto& prototypes = rdse_instance.prototypes;
+    const auto& order = rdse_instance.sorted_indices;
+    if (static_cast<int>(order.size()) != rdse_instance.size) {
+        throw std::invalid_argument("RDSEInstance has no sorted prototype index; call build_sorted_index().");
     }
-    
-    std::vector<double> distances(rdse_instance.size);
-    for(int i = 0; i < rdse_instance.size; ++i) {
-        distances[i] = std::abs(rdse_instance.prototypes[i] - value);
+    const int w = std::min(rdse_instance.active_bits, rdse_instance.size);
+
+    // `hi` is the first prototype >= value, `lo` the last one below it.
+    int hi = static_cast<int>(std::lower_bound(order.begin(), order.end(), value,
+                                               [&prototypes](int idx, double v) { return prototypes[idx] < v; }) -
+                              order.begin());
+    int lo = hi - 1;
+    const int n = static_cast<int>(order.size());
+
+    for (int taken = 0; taken < w; ++taken) {
+        bool take_hi;
+        if (lo < 0) {
+            take_hi = true;
+        } else if (hi >= n) {
+            take_hi = false;
+        } else {
+            const double d_lo = value - prototypes[order[lo]];
+            const double d_hi = prototypes[order[hi]] - value;
+            take_hi = d_hi < d_lo || (d_hi == d_lo && order[hi] < order[lo]);
+        }
+        emit(take_hi ? order[hi++] : order[lo--]);
     }
-    
-    std::vector<int> indices(rdse_instance.size);
-    std::iota(indices.begin(), indices.end(), 0); // Fill with 0, 1, 2, ...
+}
 
-    // Partially sort to find the indices of the `active_bits` smallest distances
-    std::partial_sort(indices.begin(), indices.begin() + rdse_instance.active_bits, indices.end(),
-                      [&distances](int a, int b) {
-                          return distances[a] < distances[b];
-                      });
-                      
+SDR encode_scalar(const RDSEInstance& rdse_instance, double value) {
+    // Distance on a line: the `active_bits` nearest prototypes form a contiguous
+    // window of the sorted prototype array around `value`.
     SDR sdr(rdse_instance.size, 0);
-    for (int i = 0; i < rdse_instance.active_bits; ++i) {
-        sdr[indices[i]] = 1;
-    }
-    
+    for_each_nearest_prototype(rdse_instance, value, [&sdr](int idx) { sdr[idx] = 1; });
     return sdr;
 }
 
+void encode_scalar_indices(const RDSEInstance& rdse_instance, double value, std::vector<int>& active_indices) {
+    active_indices.clear();
+    append_scalar_indices(rdse_instance, value, active_indices);
+}
+
+void append_scalar_indices(const RDSEInstance& rdse_instance, double value, std::vector<int>& active_indices) {
+    for_each_nearest_prototype(rdse_instance, value, [&active_indices](int idx) { active_indices.push_back(idx); });
+}
+
 int overlap(const SDR& sdr1, const SDR& sdr2) {
     int sum = 0;
     // Assuming sdr1 and sdr2 are the same size
@@ -11,16 +11,29 @@
 // Using a vector of 8-bit integers for the SDR, similar to numpy's int8 array
 using SDR = std::vector<int8_t>;
 
+struct RDSEInstance;
+
+/**
+ * @brief Rebuilds the prototype ordering used by encode_scalar's nearest-neighbour search.
+ * @param rdse_instance The instance whose `sorted_indices` are recomputed from `prototypes`.
+ */
+void build_sorted_index(RDSEInstance& rdse_instance);
+
 // A struct to hold the RDSE parameters, replacing the Python dictionary
 struct RDSEInstance {
     int size;
     int active_bits;
     double resolution;
     std::vector<double> prototypes;
+    // Prototype indices ordered by prototype value. Derived data, rebuilt on load.
+    std::vector<int> sorted_indices;
 
     template <class Archive>
     void serialize(Archive & ar) {
         ar(CEREAL_NVP(size), CEREAL_NVP(active_bits), CEREAL_NVP(resolution), CEREAL_NVP(prototypes));
+        if constexpr (Archive::is_loading::value) {
+            build_sorted_index(*this);
+        }
     }
 };
 
@@ -42,6 +55,22 @@ RDSEInstance create_rdse(int n, int w, double resolution, int seed = -1);
  */
 SDR encode_scalar(const RDSEInstance& rdse_instance, double value);
 
+/**
+ * @brief Finds the active bits of a scalar's SDR without materialising the dense vector.
+ * Runs in O(log n + w): a binary search over the sorted prototypes followed by a
+ * two-pointer walk outward from `value`.
+ * @param rdse_instance The RDSE configuration to use.
+ * @param value The scalar value to encode.
+ * @param active_indices Cleared and filled with the active bit indices, nearest prototype first.
+ */
+void encode_scalar_indices(const RDSEInstance& rdse_instance, double value, std::vector<int>& active_indices);
+
+/**
+ * @brief Like encode_scalar_indices, but appends to `active_indices` instead of clearing it,
+ * so several encoders can write into one buffer without a temporary.
+ */
+void append_scalar_indices(const RDSEInstance& rdse_instance, double value, std::vector<int>& active_indices);
+
 /**
  * @brief Computes the overlap (dot product) between two binary SDRs.
  * @param sdr1 The first SDR.
@@ -1,5 +1,6 @@
 // src/resonance_layer.cpp
 #include "resonance_layer.hpp"
+#include <algorithm>
 #include <stdexcept>
 
 ResonanceLayer::ResonanceLayer(int basis_sdr_size, int rdr_size, torch::Device device)
@@ -18,21 +19,79 @@ ResonanceLayer::ResonanceLayer(int basis_sdr_size, int rdr_size, torch::Device d
     torch::nn::init::normal_(_weights, 0.0, 0.01); // Mean 0.0, Stddev 0.01
 }
 
-torch::Tensor ResonanceLayer::process(const SDR& basis_sdr) {
-    if (basis_sdr.size() != _basis_sdr_size) {
+torch::Tensor ResonanceLayer::process(const SparseSdr& basis_sdr) {
+    if (basis_sdr.size != _basis_sdr_size) {
         throw std::invalid_argument("Input basis_sdr has incorrect size for ResonanceLayer.");
     }
 
-    auto cpu_options = torch::TensorOptions().dtype(torch::kFloat32);
-    torch::Tensor basis_vector = torch::zeros({_basis_sdr_size, 1}, cpu_options);
-    for(size_t i = 0; i < basis_sdr.size(); ++i) {
-        if(basis_sdr[i] > 0) {
-            basis_vector[i] = 1.0f;
+    // W * x for a binary x is the sum of W's columns at the active bits: gather those
+    // ~10 columns instead of a dense matmul. index_select is differentiable, but its
+    // backward still materializes a dense zero gradient the size of the whole weight
+    // matrix, with only the gathered columns nonzero; training keeps the update sparse
+    // by gathering into a leaf (see processBatch with `columns` and SparseColumnAdam).
+    std::vector<int64_t> indices(basis_sdr.active.begin(), basis_sdr.active.end());
+    torch::Tensor index = torch::tensor(indices, torch::kLong).to(_device);
+    torch::Tensor rdr = _weights.index_select(1, index).sum(1, /*keepdim=*/true);
+    
+    return rdr;
+}
+
+torch::Tensor ResonanceLayer::processBatch(const std::vector<SparseSdr>& basis_sdrs) {
+    return reduceColumns(basis_sdrs, _weights, nullptr);
+}
+
+torch::Tensor ResonanceLayer::processBatch(const std::vector<SparseSdr>& basis_sdrs, const std::vector<int64_t>& columns,
+                                           const torch::Tensor& column_weights) {
+    if (column_weights.size(0) != _rdr_size || column_weights.size(1) != static_cast<int64_t>(columns.size())) {
+        throw std::invalid_argument("Column weights do not match the ResonanceLayer and column list.");
+    }
+    return reduceColumns(basis_sdrs, column_weights, &columns);
+}
+
+torch::Tensor ResonanceLayer::reduceColumns(const std::vector<SparseSdr>& basis_sdrs, const torch::Tensor& weights,
+                                            const std::vector<int64_t>* columns) {
+    const int64_t steps = static_cast<int64_t>(basis_sdrs.size());
+    std::vector<int64_t> flat_indices;
+    std::vector<int64_t> step_of_index;
+    bool uniform = true;
+    const size_t active_per_step = basis_sdrs.empty() ? 0 : basis_sdrs[0].active.size();
+    for (int64_t t = 0; t < steps; ++t) {
+        const SparseSdr& basis_sdr = basis_sdrs[t];
+        if (basis_sdr.size != _basis_sdr_size) {
+            throw std::invalid_argument("Input basis_sdr has incorrect size for ResonanceLayer.");
+        }
+        uniform = uniform && basis_sdr.active.size() == active_per_step;
+        if (columns) {
+            // Basis column -> its position in the sorted column list.
+            for (int column : basis_sdr.active) {
+                auto found = std::lower_bound(columns->begin(), columns->end(), static_cast<int64_t>(column));
+                if (found == columns->end() || *found != column) {
+                    throw std::invalid_argument("Basis SDR activates a column missing from the column list.");
+                }
+                flat_indices.push_back(found - columns->begin());
+            }
+        } else {
+            flat_indices.insert(flat_indices.end(), basis_sdr.active.begin(), basis_sdr.active.end());
         }
+        step_of_index.insert(step_of_index.end(), basis_sdr.active.size(), t);
     }
 
-    basis_vector = basis_vector.to(_device);
-    torch::Tensor rdr = torch::matmul(_weights, basis_vector);
-    
-    return rdr;
-}
\ No newline at end of file
+    torch::Tensor index = torch::tensor(flat_indices, torch::kLong).to(_device);
+    torch::Tensor gathered = weights.index_select(1, index); // [rdr_size, total_active]
+
+    if (uniform && active_per_step > 0) {
+        // Every step has the same number of winners: a dense [rdr, T, active] reduction.
+        return gathered.view({_rdr_size, steps, static_cast<int64_t>(active_per_step)}).sum(2);
+    }
+    // Ragged steps (some rows had fewer winners): scatter-add the columns into their step.
+    torch::Tensor segments = torch::tensor(step_of_index, torch::kLong).to(_device);
+    torch::Tensor rdrs = torch::zeros({_rdr_size, steps}, weights.options().requires_grad(false));
+    return rdrs.index_add(1, segments, gathered);
+}
+
+torch::Tensor ResonanceLayer::process(const SDR& basis_sdr) {
+    if (basis_sdr.size() != _basis_sdr_size) {
+        throw std::invalid_argument("Input basis_sdr has incorrect size for ResonanceLayer.");
+    }
+    return process(SparseSdr::fromDense(basis_sdr));
+}
@@ -3,6 +3,7 @@
 #define RESONANCE_LAYER_HPP
 
 #include "types.hpp"
+#include "sparse_sdr.hpp"
 #include <torch/torch.h> // [SLLM ADDED] Include the main LibTorch header
 #include <cereal/cereal.hpp>
 // [SLLM NOTE] Cereal does not have native support for torch::Tensor.
@@ -14,12 +15,25 @@ public:
     ResonanceLayer(int basis_sdr_size, int rdr_size, torch::Device device);
 
     // [SLLM MODIFIED] Now returns a torch::Tensor
+    torch::Tensor process(const SparseSdr& basis_sdr);
+    // Dense adapter for existing callers
     torch::Tensor process(const SDR& basis_sdr);
 
+    // Batched form: column t of the [rdr_size, T] result is process(basis_sdrs[t]).
+    torch::Tensor processBatch(const std::vector<SparseSdr>& basis_sdrs);
+    // Same, reading the weights from `column_weights` [rdr_size, columns.size()], whose column j
+    // stands for basis column columns[j] (sorted, covering every active bit). Training passes
+    // a gathered leaf here so the gradient is only [rdr_size, columns.size()].
+    torch::Tensor processBatch(const std::vector<SparseSdr>& basis_sdrs, const std::vector<int64_t>& columns,
+                               const torch::Tensor& column_weights);
+
     const torch::Tensor& getWeights() const { return _weights; }
     torch::Tensor& getWeights() { return _weights; } // Non-const version for updates
 
 private:
+    torch::Tensor reduceColumns(const std::vector<SparseSdr>& basis_sdrs, const torch::Tensor& weights,
+                                const std::vector<int64_t>* columns);
+
     int _basis_sdr_size;
     int _rdr_size;
     torch::Device _device; // The device (CPU or CUDA) where tensors live
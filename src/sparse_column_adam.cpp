@@ -0,0 +1,110 @@
+// src/sparse_column_adam.cpp
+#include "sparse_column_adam.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+
+SparseColumnAdam::SparseColumnAdam(torch::Tensor weights, double learning_rate, double beta1, double beta2, double eps)
+    : weights_(std::move(weights)),
+      learning_rate_(learning_rate),
+      beta1_(beta1),
+      beta2_(beta2),
+      eps_(eps) {
+    if (weights_.dim() != 2) {
+        throw std::invalid_argument("SparseColumnAdam needs a 2-D weight matrix.");
+    }
+    torch::NoGradGuard no_grad;
+    exp_avg_ = torch::zeros_like(weights_);
+    exp_avg_sq_ = torch::zeros_like(weights_);
+    auto step_options = torch::TensorOptions().dtype(torch::kLong).device(weights_.device());
+    last_step_ = torch::zeros({weights_.size(1)}, step_options);
+    step_ = torch::zeros({}, step_options);
+}
+
+torch::Tensor SparseColumnAdam::gather(const torch::Tensor& columns) const {
+    return weights_.detach().index_select(1, columns).requires_grad_(true);
+}
+
+std::pair<torch::Tensor, torch::Tensor> SparseColumnAdam::catchUp(const torch::Tensor& columns) {
+    torch::Tensor last = last_step_.index_select(0, columns).to(torch::kFloat).unsqueeze(1); // [n, 1]
+    torch::Tensor skipped = step_.to(torch::kFloat) - last;                                    // [n, 1]
+    torch::Tensor exp_avg = exp_avg_.index_select(1, columns);
+    torch::Tensor exp_avg_sq = exp_avg_sq_.index_select(1, columns);
+
+    // Momentum-only drift of the skipped steps: ratio^i * sqrt(bc2(s + i)) / bc1(s + i), i = 1..k.
+    // A column never updated (s = 0) has zero moments, so its drift is zero too.
+    auto float_options = torch::TensorOptions().dtype(torch::kFloat).device(weights_.device());
+    torch::Tensor i = torch::arange(1, kDriftTerms + 1, float_options).unsqueeze(0);            // [1, K]
+    torch::Tensor n = last + i;                                                                 // [n, K]
+    const double ratio = beta1_ / std::sqrt(beta2_);
+    torch::Tensor terms = torch::pow(ratio, i) * (1.0 - torch::pow(beta2_, n)).sqrt() / (1.0 - torch::pow(beta1_, n));
+    torch::Tensor drift_scale = terms.masked_fill(i.gt(skipped), 0.0).masked_fill(last.eq(0), 0.0).sum(1); // [n]
+    torch::Tensor drift = exp_avg / (exp_avg_sq.sqrt().add_(eps_)) * (drift_scale * -learning_rate_).unsqueeze(0);
+    weights_.index_add_(1, columns, drift);
+
+    torch::Tensor skipped_row = skipped.squeeze(1).unsqueeze(0);                               // [1, n]
+    exp_avg.mul_(torch::pow(beta1_, skipped_row));
+    exp_avg_sq.mul_(torch::pow(beta2_, skipped_row));
+    return {exp_avg, exp_avg_sq};
+}
+
+void SparseColumnAdam::step(const torch::Tensor& columns, const torch::Tensor& grad, const torch::Tensor& apply) {
+    torch::NoGradGuard no_grad;
+    // Catching up is valid either way: it only brings the columns to the last applied step.
+    torch::Tensor exp_avg, exp_avg_sq;
+    std::tie(exp_avg, exp_avg_sq) = catchUp(columns);
+    step_ += apply.to(torch::kLong);
+
+    torch::Tensor new_exp_avg = exp_avg * beta1_ + grad * (1.0 - beta1_);
+    torch::Tensor new_exp_avg_sq = exp_avg_sq * beta2_ + grad * grad * (1.0 - beta2_);
+
+    // Bias corrections from the device step count; on a masked first step they divide by zero,
+    // but that update is discarded by the where below.
+    torch::Tensor step = step_.to(torch::kDouble);
+    torch::Tensor bias_correction1 = 1.0 - torch::pow(beta1_, step);
+    torch::Tensor bias_correction2 = 1.0 - torch::pow(beta2_, step);
+    torch::Tensor denom = new_exp_avg_sq.sqrt() / bias_correction2.sqrt() + eps_;
+    torch::Tensor update = new_exp_avg / denom * (-learning_rate_ / bias_correction1);
+
+    weights_.index_add_(1, columns, torch::where(apply, update, torch::zeros_like(update)));
+    exp_avg_.index_copy_(1, columns, torch::where(apply, new_exp_avg, exp_avg));
+    exp_avg_sq_.index_copy_(1, columns, torch::where(apply, new_exp_avg_sq, exp_avg_sq));
+    last_step_.index_fill_(0, columns, step_);
+}
+
+void SparseColumnAdam::flush() {
+    torch::NoGradGuard no_grad;
+    torch::Tensor columns = torch::arange(weights_.size(1), torch::TensorOptions().dtype(torch::kLong).device(weights_.device()));
+    torch::Tensor exp_avg, exp_avg_sq;
+    std::tie(exp_avg, exp_avg_sq) = catchUp(columns);
+    exp_avg_ = exp_avg;
+    exp_avg_sq_ = exp_avg_sq;
+    last_step_.fill_(step_);
+}
+
+std::vector<std::pair<std::string, torch::Tensor>> SparseColumnAdam::namedState() const {
+    return {
+        {"column_adam_exp_avg", exp_avg_},
+        {"column_adam_exp_avg_sq", exp_avg_sq_},
+        {"column_adam_last_step", last_step_},
+        {"column_adam_step", step_},
+    };
+}
+
+void SparseColumnAdam::loadState(const std::vector<std::pair<std::string, torch::Tensor>>& state) {
+    torch::NoGradGuard no_grad;
+    const torch::Device device = weights_.device();
+    for (const auto& named : state) {
+        const torch::Tensor& value = named.second;
+        if (named.first == "column_adam_step") {
+            if (value.numel() != 1) throw std::runtime_error("Column Adam state has the wrong shape.");
+            step_ = value.to(torch::kLong).reshape({}).to(device);
+        } else if (named.first == "column_adam_last_step") {
+            if (value.sizes() != last_step_.sizes()) throw std::runtime_error("Column Adam state has the wrong shape.");
+            last_step_ = value.to(device).to(torch::kLong);
+        } else if (named.first == "column_adam_exp_avg" || named.first == "column_adam_exp_avg_sq") {
+            if (value.sizes() != weights_.sizes()) throw std::runtime_error("Column Adam state has the wrong shape.");
+            (named.first == "column_adam_exp_avg" ? exp_avg_ : exp_avg_sq_) = value.to(device);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+// src/sparse_column_adam.hpp
+#ifndef SPARSE_COLUMN_ADAM_HPP
+#define SPARSE_COLUMN_ADAM_HPP
+
+#include <torch/torch.h>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Lazy Adam over the columns of a weight matrix that a step actually touches.
+ *
+ * The ResonanceLayer reads ~10 of its basis columns per token, so a training chunk's
+ * gradient is zero outside the columns its basis SDRs activate. Instead of a dense
+ * [rows, cols] gradient and a dense Adam sweep over the weights and both moments, the
+ * touched columns are gathered into a small leaf tensor (gather()), backprop fills its
+ * gradient, and step() updates only those columns of the weights and moments.
+ *
+ * A column skipped for k steps is caught up when it is next touched (or on flush()).
+ * Dense Adam would have decayed its moments by beta^k on those steps, and moved the weights
+ * by the momentum alone. The decay is exact. The drift is replayed in closed form as
+ *   lr * m / sqrt(v) * sum_i (beta1 / sqrt(beta2))^i * sqrt(1 - beta2^(s+i)) / (1 - beta1^(s+i)),
+ * where s is the column's last step. That formula drops eps from the skipped steps and cuts the
+ * sum at kDriftTerms (the ratio^i factor is negligible by then), so the weights match dense
+ * Adam to within rounding for any eps well below sqrt(v).
+ */
+class SparseColumnAdam {
+public:
+    // `weights` is updated in place (under no-grad); it is not read through autograd here.
+    SparseColumnAdam(torch::Tensor weights, double learning_rate, double beta1 = 0.9, double beta2 = 0.999,
+                     double eps = 1e-8);
+
+    // The columns `columns` (unique, long, on the weights' device) of the weights as a fresh
+    // [rows, columns.numel()] leaf that requires grad.
+    torch::Tensor gather(const torch::Tensor& columns) const;
+
+    // One Adam step for `columns` with `grad` [rows, columns.numel()] (the gathered leaf's
+    // gradient), applied only where the 0-dim bool `apply` is true. Runs entirely on device: a
+    // masked step leaves the weights, moments and step count as they were.
+    void step(const torch::Tensor& columns, const torch::Tensor& grad, const torch::Tensor& apply);
+
+    // Catches every column up to the current step, so the weights equal dense Adam's. One
+    // dense pass; run it before the weights are read (evaluation, saving).
+    void flush();
+
+    // Rebinds to a new weights tensor of the same shape (e.g. after a model reload).
+    void setWeights(torch::Tensor weights) { weights_ = std::move(weights); }
+
+    // Moments, per-column last-update steps and the step count, keyed for checkpoints.
+    std::vector<std::pair<std::string, torch::Tensor>> namedState() const;
+    // Restores entries in namedState()'s format (same keys and shapes).
+    void loadState(const std::vector<std::pair<std::string, torch::Tensor>>& state);
+
+private:
+    // Applies the skipped-step decay and drift to `columns`, bringing them to `step_` (the last
+    // applied step); returns their caught-up moments.
+    std::pair<torch::Tensor, torch::Tensor> catchUp(const torch::Tensor& columns);
+
+    static constexpr int64_t kDriftTerms = 256;
+
+    torch::Tensor weights_;
+    torch::Tensor exp_avg_;     // [rows, cols]
+    torch::Tensor exp_avg_sq_;  // [rows, cols]
+    torch::Tensor last_step_;   // [cols], long: the step each column was last updated at
+    torch::Tensor step_;        // 0-dim long on the weights' device: applied steps so far
+    double learning_rate_;
+    double beta1_;
+    double beta2_;
+    double eps_;
+};
+
+#endif // SPARSE_COLUMN_ADAM_HPP
@@ -0,0 +1,45 @@
+// src/sparse_sdr.cpp
+#include "sparse_sdr.hpp"
+
+SparseSdr SparseSdr::fromDense(const SDR& sdr) {
+    SparseSdr sparse;
+    sparse.size = static_cast<int>(sdr.size());
+    for (size_t i = 0; i < sdr.size(); ++i) {
+        if (sdr[i] > 0) sparse.active.push_back(static_cast<int>(i));
+    }
+    return sparse;
+}
+
+SDR SparseSdr::toDense() const {
+    SDR sdr(size, 0);
+    for (int idx : active) {
+        sdr[idx] = 1;
+    }
+    return sdr;
+}
+
+void ConcatenatedSdr::append(const SparseSdr& part) {
+    parts_.push_back({&part, size_});
+    size_ += part.size;
+}
+
+void ConcatenatedSdr::clear() {
+    parts_.clear();
+    size_ = 0;
+}
+
+int ConcatenatedSdr::activeCount() const {
+    int count = 0;
+    for (const auto& part : parts_) {
+        count += static_cast<int>(part.sdr->active.size());
+    }
+    return count;
+}
+
+SparseSdr ConcatenatedSdr::flatten() const {
+    SparseSdr flat;
+    flat.size = size_;
+    flat.active.reserve(activeCount());
+    forEachActive([&flat](int idx) { flat.active.push_back(idx); });
+    return flat;
+}
@@ -0,0 +1,73 @@
+// src/sparse_sdr.hpp
+#ifndef SPARSE_SDR_HPP
+#define SPARSE_SDR_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cereal/cereal.hpp>
+#include <cereal/types/vector.hpp>
+
+using SDR = std::vector<int8_t>;
+
+/**
+ * @brief An SDR stored as the sorted indices of its active bits.
+ *
+ * At 2% sparsity this is ~40 ints instead of 2048 bytes, and every consumer
+ * (pooler overlap, resonance gather) only needs the active bits anyway.
+ */
+struct SparseSdr {
+    int size = 0;
+    std::vector<int> active; // Sorted ascending, no duplicates
+
+    static SparseSdr fromDense(const SDR& sdr);
+    SDR toDense() const;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(size), CEREAL_NVP(active));
+    }
+};
+
+/**
+ * @brief A zero-copy concatenation of sparse SDRs.
+ *
+ * Holds pointers to its parts (which must outlive the view) and shifts each
+ * part's indices by the total size of the parts before it, so e.g. the token
+ * and position SDRs can be fed to the pooler without building the 4096-bit
+ * concatenated input.
+ */
+class ConcatenatedSdr {
+public:
+    ConcatenatedSdr() = default;
+
+    void append(const SparseSdr& part);
+    // Only a pointer is kept, so a temporary part would dangle.
+    void append(SparseSdr&&) = delete;
+    // Drops all parts but keeps the storage for reuse.
+    void clear();
+
+    int size() const { return size_; }
+    int activeCount() const;
+
+    // Calls `f(index)` for every active bit of the concatenation in ascending order.
+    template <typename F>
+    void forEachActive(F&& f) const {
+        for (const auto& part : parts_) {
+            for (int idx : part.sdr->active) {
+                f(part.offset + idx);
+            }
+        }
+    }
+
+    SparseSdr flatten() const;
+
+private:
+    struct Part {
+        const SparseSdr* sdr;
+        int offset;
+    };
+    std::vector<Part> parts_;
+    int size_ = 0;
+};
+
+#endif // SPARSE_SDR_HPP
@@ -1,15 +1,18 @@
 // src/spatial_pooler.cpp
 #include "spatial_pooler.hpp"
+#include "top_k.hpp"
+#include "fnv_hash.hpp"
 #include <iostream>
 #include <algorithm>
 #include <numeric>
+#include <stdexcept>
 
 SpatialPooler::SpatialPooler(int input_size, int num_columns, int layer_index, float potential_ratio,
                              float syn_perm_active_inc, float syn_perm_inactive_dec,
                              float syn_perm_connected, int num_active_cols_per_inhib,
-                             int stimulus_threshold, int boost_strength)
+                             int stimulus_threshold, int boost_strength, SynapseStorage storage)
     : _input_size(input_size), _num_columns(num_columns), _layerIndex(layer_index),
-      _permanences(num_columns, input_size), _boost_factors(num_columns),
+      _storage(storage), _boost_factors(num_columns),
       _active_duty_cycle(num_columns), _overlap_duty_cycle(num_columns),
       _syn_perm_active_inc(syn_perm_active_inc),
       _syn_perm_inactive_dec(syn_perm_inactive_dec),
@@ -25,24 +28,57 @@ SpatialPooler::SpatialPooler(int input_size, int num_columns, int layer_index, f
     _overlap_duty_cycle.setZero();
 }
 
+namespace {
+
+const float kQuantizedScale = 255.0f;
+
+uint8_t quantizePermanence(float permanence) {
+    return static_cast<uint8_t>(std::clamp(permanence, 0.0f, 1.0f) * kQuantizedScale + 0.5f);
+}
+
+} // namespace
+
 void SpatialPooler::initializePermanences(float potential_ratio) {
-    std::uniform_real_distribution<float> dist(0.0, 1.0);
+    // One 32-bit draw per synapse: the low half decides pool membership, the high half
+    // places the permanence in [connected - 0.1, connected + 0.1).
+    const uint32_t potential_cutoff = static_cast<uint32_t>(std::clamp(potential_ratio, 0.0f, 1.0f) * 65536.0f);
+    const float low = _syn_perm_connected - 0.1f;
+    const float span = 0.2f / 65536.0f;
+    auto draw = [&]() {
+        const uint32_t r = static_cast<uint32_t>(_gen());
+        return (r & 0xFFFFu) < potential_cutoff ? low + span * static_cast<float>(r >> 16) : 0.0f;
+    };
+
+    if (_storage == SynapseStorage::Quantized) {
+        _permanences.resize(0, 0);
+        _permanences_by_input.resize(0, 0);
+        _quantized_permanences.resize(static_cast<size_t>(_num_columns) * _input_size);
+        for (int i = 0; i < _num_columns; ++i) {
+            for (int j = 0; j < _input_size; ++j) {
+                _quantized_permanences[static_cast<size_t>(j) * _num_columns + i] = quantizePermanence(draw());
+            }
+        }
+        return;
+    }
+
+    _quantized_permanences.clear();
+    _permanences.resize(_num_columns, _input_size);
     for (int i = 0; i < _num_columns; ++i) {
         for (int j = 0; j < _input_size; ++j) {
-            if (dist(_gen) < potential_ratio) {
-                _permanences(i, j) = std::uniform_real_distribution<float>(
-                    _syn_perm_connected - 0.1f, _syn_perm_connected + 0.1f)(_gen);
-            } else {
-                _permanences(i, j) = 0.0f;
-            }
+            _permanences(i, j) = draw();
         }
     }
+    _permanences_by_input = _permanences;
 }
 
 int SpatialPooler::getLayerIndex() const {
     return _layerIndex;
 }
 
+SpatialPooler::SynapseStorage SpatialPooler::getSynapseStorage() const {
+    return _storage;
+}
+
 void SpatialPooler::enablePlasticity(float active_inc, float inactive_dec) {
     _plasticity_enabled = true;
     _syn_perm_active_inc = active_inc;
@@ -53,67 +89,234 @@ void SpatialPooler::disablePlasticity() {
     _plasticity_enabled = false;
 }
 
-VectorXf SpatialPooler::calculateOverlap(const SDR& input_sdr) {
-    VectorXf input_sdr_vector(_input_size);
-    for (size_t i = 0; i < input_sdr.size(); ++i) {
-        input_sdr_vector(i) = (input_sdr[i] > 0) ? 1.0f : 0.0f;
+void SpatialPooler::calculateOverlap(const ConcatenatedSdr& input, float* overlaps_out,
+                                     std::vector<uint16_t>& sum_scratch) const {
+    // _permanences * x for a binary x is the sum of the permanence columns of the
+    // active inputs: ~80 contiguous column reads instead of the full matrix.
+    Eigen::Map<VectorXf> overlaps(overlaps_out, _num_columns);
+    overlaps.setZero();
+    if (_storage == SynapseStorage::Quantized) {
+        // Widening uint8 -> uint16 adds vectorize well; 257 columns of 255 still fit in
+        // 16 bits, so the partial sums are flushed to float every 256 inputs.
+        std::vector<uint16_t>& sums = sum_scratch;
+        sums.assign(_num_columns, 0);
+        int pending = 0;
+        auto flush = [&]() {
+            for (int c = 0; c < _num_columns; ++c) overlaps(c) += static_cast<float>(sums[c]);
+            std::fill(sums.begin(), sums.end(), 0);
+            pending = 0;
+        };
+        input.forEachActive([&](int idx) {
+            const uint8_t* column = _quantized_permanences.data() + static_cast<size_t>(idx) * _num_columns;
+            uint16_t* acc = sums.data();
+            for (int c = 0; c < _num_columns; ++c) acc[c] += column[c];
+            if (++pending == 256) flush();
+        });
+        if (pending > 0) flush();
+        overlaps /= kQuantizedScale;
+    } else {
+        input.forEachActive([this, &overlaps](int idx) { overlaps += _permanences_by_input.col(idx); });
     }
+    overlaps.array() *= _boost_factors.array();
+}
 
-    VectorXf overlaps = _permanences * input_sdr_vector;
-    overlaps = overlaps.array() * _boost_factors.array();
-    return overlaps;
+void SpatialPooler::getActiveColumns(const VectorXf& overlaps, std::vector<int>& active_columns) const {
+    // k-winners-take-all: a fused threshold + top-k pass, written into the caller's buffer.
+    active_columns.resize(_num_active_cols_per_inhib);
+    int count = selectTopK(overlaps.data(), _num_columns, _num_active_cols_per_inhib,
+                           static_cast<float>(_stimulus_threshold), active_columns.data());
+    active_columns.resize(count);
 }
 
-std::vector<int> SpatialPooler::getActiveColumns(const VectorXf& overlaps) {
-    std::vector<int> active_columns;
-    std::vector<std::pair<float, int>> sorted_overlaps;
-    for (int i = 0; i < _num_columns; ++i) {
-        if (overlaps(i) > _stimulus_threshold) {
-            sorted_overlaps.push_back({-overlaps(i), i});
+void SpatialPooler::updatePermanences(const ConcatenatedSdr& input, const std::vector<int>& active_columns) {
+    if (!_plasticity_enabled || active_columns.empty()) return;
+
+    const int num_active = static_cast<int>(active_columns.size());
+
+    if (_storage == SynapseStorage::Quantized) {
+        const int inc = std::max(1, static_cast<int>(_syn_perm_active_inc * kQuantizedScale + 0.5f));
+        const int dec = std::max(1, static_cast<int>(_syn_perm_inactive_dec * kQuantizedScale + 0.5f));
+        std::vector<int8_t> input_active(_input_size, 0);
+        input.forEachActive([&input_active](int idx) { input_active[idx] = 1; });
+
+        // Input-major storage: each thread owns a range of inputs and walks the active columns.
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < _input_size; ++i) {
+            uint8_t* synapses = _quantized_permanences.data() + static_cast<size_t>(i) * _num_columns;
+            const int delta = input_active[i] > 0 ? inc : -dec;
+            for (int a = 0; a < num_active; ++a) {
+                uint8_t& q = synapses[active_columns[a]];
+                q = static_cast<uint8_t>(std::clamp(q + delta, 0, 255));
+            }
         }
+        return;
     }
-    std::sort(sorted_overlaps.begin(), sorted_overlaps.end());
-    int count = std::min((int)sorted_overlaps.size(), _num_active_cols_per_inhib);
 
-    for (int i = 0; i < count; ++i) {
-        active_columns.push_back(sorted_overlaps[i].second);
+    // Per-input step: +inc on active inputs, -dec elsewhere. Adding the signed step and
+    // clamping to [0, 1] is exactly the old branchy increment/decrement.
+    Eigen::RowVectorXf delta = Eigen::RowVectorXf::Constant(_input_size, -_syn_perm_inactive_dec);
+    input.forEachActive([this, &delta](int idx) { delta(idx) = _syn_perm_active_inc; });
+
+    #pragma omp parallel for schedule(static) if (num_active > 1)
+    for (int a = 0; a < num_active; ++a) {
+        auto row = _permanences.row(active_columns[a]).array();
+        row = (row + delta.array()).max(0.0f).min(1.0f);
+    }
+
+    // Mirror the updated rows, walking the column-major copy one input at a time.
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < _input_size; ++i) {
+        for (int a = 0; a < num_active; ++a) {
+            _permanences_by_input(active_columns[a], i) = _permanences(active_columns[a], i);
+        }
     }
-    return active_columns;
 }
 
-void SpatialPooler::updatePermanences(const SDR& input_sdr, const std::vector<int>& active_columns) {
-    if (!_plasticity_enabled) return;
+void SpatialPooler::updateDutyCycles(const VectorXf& overlaps, const std::vector<int>& active_columns) {
+    // Moving averages over min(iterations, period) steps, as in HTM's spatial pooler.
+    ++_iteration_num;
+    const float period = static_cast<float>(std::min<long long>(_iteration_num, _duty_cycle_period));
 
-    for (int col_idx : active_columns) {
-        for (int i = 0; i < _input_size; ++i) {
-            if (input_sdr[i] > 0) {
-                _permanences(col_idx, i) += _syn_perm_active_inc;
-                _permanences(col_idx, i) = std::min(1.0f, _permanences(col_idx, i));
-            } else {
-                _permanences(col_idx, i) -= _syn_perm_inactive_dec;
-                _permanences(col_idx, i) = std::max(0.0f, _permanences(col_idx, i));
-            }
+    VectorXf active = VectorXf::Zero(_num_columns);
+    for (int col : active_columns) active(col) = 1.0f;
+    const VectorXf overlapped =
+        (overlaps.array() > static_cast<float>(_stimulus_threshold)).cast<float>().matrix();
+
+    _active_duty_cycle = (_active_duty_cycle * (period - 1.0f) + active) / period;
+    _overlap_duty_cycle = (_overlap_duty_cycle * (period - 1.0f) + overlapped) / period;
+}
+
+void SpatialPooler::boostColumns() {
+    // Exponential boosting towards the target density of k winners per step: columns
+    // that win less often than their share get boosted, frequent winners damped.
+    if (_boost_strength <= 0) {
+        _boost_factors.setOnes();
+        return;
+    }
+    const float target_density = static_cast<float>(_num_active_cols_per_inhib) / _num_columns;
+    _boost_factors = (-static_cast<float>(_boost_strength) *
+                      (_active_duty_cycle.array() - target_density)).exp().matrix();
+}
+
+void SpatialPooler::process(const ConcatenatedSdr& input, bool learn, SparseSdr& output) {
+    if (input.size() != _input_size) {
+        throw std::invalid_argument("Input SDR has incorrect size for SpatialPooler.");
+    }
+    _overlap_scratch.resize(_num_columns);
+    calculateOverlap(input, _overlap_scratch.data(), _quantized_sum_scratch);
+    getActiveColumns(_overlap_scratch, output.active);
+    if (learn) {
+        updatePermanences(input, output.active);
+        updateDutyCycles(_overlap_scratch, output.active);
+        boostColumns();
+    }
+
+    output.size = _num_columns;
+    std::sort(output.active.begin(), output.active.end());
+}
+
+SparseSdr SpatialPooler::process(const ConcatenatedSdr& input, bool learn) {
+    SparseSdr output_sdr;
+    process(input, learn, output_sdr);
+    return output_sdr;
+}
+
+std::vector<SparseSdr> SpatialPooler::processBatch(const std::vector<ConcatenatedSdr>& inputs, bool learn) {
+    if (!learn) return inferBatch(inputs);
+
+    // Learning makes each step depend on the previous one, so it stays sequential.
+    const int batch_size = static_cast<int>(inputs.size());
+    std::vector<SparseSdr> outputs(batch_size);
+    for (int b = 0; b < batch_size; ++b) {
+        process(inputs[b], true, outputs[b]);
+    }
+    return outputs;
+}
+
+std::vector<SparseSdr> SpatialPooler::inferBatch(const std::vector<ConcatenatedSdr>& inputs) const {
+    const int batch_size = static_cast<int>(inputs.size());
+    std::vector<SparseSdr> outputs(batch_size);
+    for (const auto& input : inputs) {
+        if (input.size() != _input_size) {
+            throw std::invalid_argument("Input SDR has incorrect size for SpatialPooler.");
         }
     }
+
+    // Frozen pooler: the overlaps of the whole block are a sparse(inputs) x dense(permanences)
+    // product, one row per input, followed by k-winners on every row. Both are parallel.
+    MatrixXf overlaps(batch_size, _num_columns);
+    #pragma omp parallel
+    {
+        std::vector<uint16_t> sum_scratch;
+        #pragma omp for schedule(static)
+        for (int b = 0; b < batch_size; ++b) {
+            calculateOverlap(inputs[b], overlaps.row(b).data(), sum_scratch);
+        }
+    }
+
+    const int k = _num_active_cols_per_inhib;
+    std::vector<int> winners(static_cast<size_t>(batch_size) * k);
+    std::vector<int> counts(batch_size);
+    selectTopKRows(overlaps.data(), batch_size, _num_columns, k, static_cast<float>(_stimulus_threshold),
+                   winners.data(), counts.data());
+
+    for (int b = 0; b < batch_size; ++b) {
+        outputs[b].size = _num_columns;
+        outputs[b].active.assign(winners.begin() + static_cast<size_t>(b) * k,
+                                 winners.begin() + static_cast<size_t>(b) * k + counts[b]);
+        std::sort(outputs[b].active.begin(), outputs[b].active.end());
+    }
+    return outputs;
 }
 
-void SpatialPooler::boostColumns(const std::vector<int>& active_columns) {
-    // Simplified boosting logic for now
+std::vector<SparseSdr> SpatialPooler::processBatch(const std::vector<SparseSdr>& inputs, bool learn) {
+    std::vector<ConcatenatedSdr> views(inputs.size());
+    for (size_t b = 0; b < inputs.size(); ++b) {
+        views[b].append(inputs[b]);
+    }
+    return processBatch(views, learn);
 }
 
-SDR SpatialPooler::process(const SDR& input_sdr, bool learn) {
-    VectorXf overlaps = calculateOverlap(input_sdr);
-    std::vector<int> active_columns_indices = getActiveColumns(overlaps);
-    if (learn) {
-        updatePermanences(input_sdr, active_columns_indices);
-        boostColumns(active_columns_indices);
+std::vector<SDR> SpatialPooler::processBatch(const std::vector<SDR>& inputs, bool learn) {
+    std::vector<SparseSdr> sparse_inputs;
+    sparse_inputs.reserve(inputs.size());
+    for (const auto& input : inputs) {
+        sparse_inputs.push_back(SparseSdr::fromDense(input));
+    }
+    std::vector<SparseSdr> sparse_outputs = processBatch(sparse_inputs, learn);
+    std::vector<SDR> outputs;
+    outputs.reserve(sparse_outputs.size());
+    for (const auto& output : sparse_outputs) {
+        outputs.push_back(output.toDense());
     }
+    return outputs;
+}
+
+SparseSdr SpatialPooler::process(const SparseSdr& input, bool learn) {
+    ConcatenatedSdr view;
+    view.append(input);
+    return process(view, learn);
+}
 
-    SDR output_sdr(_num_columns, 0);
-    for (int idx : active_columns_indices) {
-        output_sdr[idx] = 1;
+SDR SpatialPooler::process(const SDR& input_sdr, bool learn) {
+    return process(SparseSdr::fromDense(input_sdr), learn).toDense();
+}
+
+uint64_t SpatialPooler::stateHash() const {
+    Fnv1a64 hash;
+    hash.updateValue(_input_size);
+    hash.updateValue(_num_columns);
+    hash.updateValue(_storage);
+    hash.updateValue(_syn_perm_connected);
+    hash.updateValue(_num_active_cols_per_inhib);
+    hash.updateValue(_stimulus_threshold);
+    if (_storage == SynapseStorage::Quantized) {
+        hash.updateVector(_quantized_permanences);
+    } else {
+        hash.update(_permanences.data(), static_cast<std::size_t>(_permanences.size()) * sizeof(float));
     }
-    return output_sdr;
+    hash.update(_boost_factors.data(), static_cast<std::size_t>(_boost_factors.size()) * sizeof(float));
+    return hash.digest();
 }
 
 int SpatialPooler::getNumColumns() const {
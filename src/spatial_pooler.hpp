@@ -3,39 +3,85 @@
 #define SPATIAL_POOLER_HPP
 
 #include "types.hpp" // <-- ADDED
+#include "sparse_sdr.hpp"
+#include <cstdint>
 #include <random>
+#include <vector>
 #include "progress_bar.hpp"
 
 class SpatialPooler {
 public:
+    // How synapse permanences are stored. Float keeps the full-precision matrix (and its
+    // column-major mirror) for learning-accuracy comparisons; Quantized keeps one uint8
+    // fixed-point value per synapse (permanence * 255), a quarter of the float footprint.
+    enum class SynapseStorage { Float, Quantized };
+
     SpatialPooler() = default;
     SpatialPooler(int input_size, int num_columns, int layer_index, float potential_ratio = 0.5f,
                   float syn_perm_active_inc = 0.01f, float syn_perm_inactive_dec = 0.005f,
                   float syn_perm_connected = 0.5f, int num_active_cols_per_inhib = 10,
-                  int stimulus_threshold = 5, int boost_strength = 1);
+                  int stimulus_threshold = 5, int boost_strength = 1,
+                  SynapseStorage storage = SynapseStorage::Float);
 
+    // Sparse pipeline: the input is read as active indices and the winning columns
+    // come back sorted. The dense overload is a thin adapter for existing callers.
+    SparseSdr process(const ConcatenatedSdr& input, bool learn);
+    // Out-parameter form: reuses `output`'s storage, so steady-state calls do not allocate.
+    void process(const ConcatenatedSdr& input, bool learn, SparseSdr& output);
+    SparseSdr process(const SparseSdr& input, bool learn);
     SDR process(const SDR& input_sdr, bool learn);
+
+    // Processes a block of inputs at once. With learn=false the overlaps and k-winners of
+    // all rows are computed in parallel and match the sequential process() exactly; with
+    // learn=true the inputs are applied in order.
+    std::vector<SparseSdr> processBatch(const std::vector<ConcatenatedSdr>& inputs, bool learn);
+    // The learn=false batch as a const call: reads the synapses only, so several threads may
+    // run it at once (e.g. training-data prefetch workers).
+    std::vector<SparseSdr> inferBatch(const std::vector<ConcatenatedSdr>& inputs) const;
+    std::vector<SparseSdr> processBatch(const std::vector<SparseSdr>& inputs, bool learn);
+    std::vector<SDR> processBatch(const std::vector<SDR>& inputs, bool learn);
     int getNumColumns() const;
+    int getNumActiveColumns() const { return _num_active_cols_per_inhib; }
+    // Fingerprint of everything a frozen process() result depends on (sizes, thresholds,
+    // synapses and boost factors), for keying caches of its output.
+    uint64_t stateHash() const;
     int getLayerIndex() const;
+    SynapseStorage getSynapseStorage() const;
     void enablePlasticity(float active_inc, float inactive_dec);
     void disablePlasticity();
     
     template<class Archive>
     void serialize(Archive& ar) {
-        ar(_input_size, _num_columns, _layerIndex, _permanences, _boost_factors, _active_duty_cycle, _overlap_duty_cycle);
+        ar(_input_size, _num_columns, _layerIndex, _storage, _permanences, _quantized_permanences,
+           _boost_factors, _active_duty_cycle, _overlap_duty_cycle);
+        if constexpr (Archive::is_loading::value) {
+            if (_storage == SynapseStorage::Float) _permanences_by_input = _permanences;
+        }
     }
 
 private:
     void initializePermanences(float potential_ratio);
-    VectorXf calculateOverlap(const SDR& input_sdr);
-    std::vector<int> getActiveColumns(const VectorXf& overlaps);
-    void updatePermanences(const SDR& input_sdr, const std::vector<int>& active_columns);
-    void boostColumns(const std::vector<int>& active_columns);
+    // Writes _num_columns boosted overlaps to `overlaps_out`. Const, so it is safe to call
+    // from several threads; the Quantized path accumulates in the caller's `sum_scratch`
+    // (one per thread), which is sized on first use and then reused without allocating.
+    void calculateOverlap(const ConcatenatedSdr& input, float* overlaps_out,
+                          std::vector<uint16_t>& sum_scratch) const;
+    void getActiveColumns(const VectorXf& overlaps, std::vector<int>& active_columns) const;
+    void updatePermanences(const ConcatenatedSdr& input, const std::vector<int>& active_columns);
+    void updateDutyCycles(const VectorXf& overlaps, const std::vector<int>& active_columns);
+    void boostColumns();
 
     int _input_size;
     int _num_columns;
     int _layerIndex;
+    SynapseStorage _storage = SynapseStorage::Float;
     MatrixXf _permanences;
+    // Column-major mirror of _permanences: the synapses of one input bit are contiguous,
+    // so overlap only reads the columns of active inputs. Kept in sync with learning.
+    Eigen::MatrixXf _permanences_by_input;
+    // Quantized storage, input-major like the mirror above: entry [j * _num_columns + c]
+    // is the permanence of column c's synapse on input j.
+    std::vector<uint8_t> _quantized_permanences;
     VectorXf _boost_factors;
     VectorXf _active_duty_cycle;
     VectorXf _overlap_duty_cycle;
@@ -45,8 +91,12 @@ private:
     int _num_active_cols_per_inhib;
     int _stimulus_threshold;
     int _boost_strength;
+    int _duty_cycle_period = 1000;
+    long long _iteration_num = 0;
     bool _plasticity_enabled;
     std::mt19937 _gen;
+    VectorXf _overlap_scratch;
+    std::vector<uint16_t> _quantized_sum_scratch;
 };
 
 #endif // SPATIAL_POOLER_HPP
\ No newline at end of file
@@ -1,11 +1,16 @@
 // src/temporal_memory.cpp
 #include "temporal_memory.hpp"
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
-TemporalMemory::TemporalMemory(int rdr_input_size, int num_cells, torch::Device device)
+TemporalMemory::TemporalMemory(int rdr_input_size, int num_cells, torch::Device device,
+                               RecurrentStructure structure, int recurrent_dim)
     : _num_cells(num_cells),
       _rdr_input_size(rdr_input_size),
-      _device(device) {
+      _device(device),
+      _structure(structure),
+      _recurrent_dim(recurrent_dim) {
 
     auto options = torch::TensorOptions()
                        .dtype(torch::kFloat32)
@@ -13,16 +18,61 @@ TemporalMemory::TemporalMemory(int rdr_input_size, int num_cells, torch::Device
                        .requires_grad(true);
 
     _input_weights = torch::empty({_num_cells, _rdr_input_size}, options);
-    _recurrent_weights = torch::empty({_num_cells, _num_cells}, options);
     _bias = torch::empty({_num_cells, 1}, options);
 
     torch::nn::init::normal_(_input_weights, 0.0, 0.01);
-    torch::nn::init::normal_(_recurrent_weights, 0.0, 0.01);
     torch::nn::init::normal_(_bias, 0.0, 0.01);
+    initializeRecurrentWeights(options);
     
     resetStates();
 }
 
+void TemporalMemory::initializeRecurrentWeights(const torch::TensorOptions& options) {
+    switch (_structure) {
+        case RecurrentStructure::Dense:
+            _recurrent_dim = _num_cells;
+            _recurrent_weights = torch::empty({_num_cells, _num_cells}, options);
+            torch::nn::init::normal_(_recurrent_weights, 0.0, 0.01);
+            break;
+        case RecurrentStructure::LowRank: {
+            if (_recurrent_dim <= 0) _recurrent_dim = std::max(1, _num_cells / 16);
+            if (_recurrent_dim > _num_cells) {
+                throw std::invalid_argument("TemporalMemory low-rank recurrence needs rank <= num_cells.");
+            }
+            // Entries of U * V^T then have the same 0.01 std as the dense initialization.
+            const double factor_std = std::sqrt(0.01 / std::sqrt(static_cast<double>(_recurrent_dim)));
+            _recurrent_u = torch::empty({_num_cells, _recurrent_dim}, options);
+            _recurrent_v = torch::empty({_num_cells, _recurrent_dim}, options);
+            torch::nn::init::normal_(_recurrent_u, 0.0, factor_std);
+            torch::nn::init::normal_(_recurrent_v, 0.0, factor_std);
+            break;
+        }
+        case RecurrentStructure::BlockDiagonal:
+            if (_recurrent_dim <= 0) _recurrent_dim = std::min(_num_cells, 512);
+            if (_num_cells % _recurrent_dim != 0) {
+                throw std::invalid_argument("TemporalMemory block size must divide num_cells.");
+            }
+            _recurrent_weights = torch::empty({_num_cells / _recurrent_dim, _recurrent_dim, _recurrent_dim}, options);
+            torch::nn::init::normal_(_recurrent_weights, 0.0, 0.01);
+            break;
+    }
+}
+
+torch::Tensor TemporalMemory::recurrentProduct(const torch::Tensor& h) const {
+    switch (_structure) {
+        case RecurrentStructure::LowRank:
+            return torch::matmul(_recurrent_u, torch::matmul(_recurrent_v.t(), h));
+        case RecurrentStructure::BlockDiagonal: {
+            const int64_t blocks = _num_cells / _recurrent_dim;
+            return torch::bmm(_recurrent_weights, h.reshape({blocks, _recurrent_dim, h.size(1)}))
+                .reshape({_num_cells, h.size(1)});
+        }
+        case RecurrentStructure::Dense:
+        default:
+            return torch::matmul(_recurrent_weights, h);
+    }
+}
+
 void TemporalMemory::resetStates() {
     _cell_activations = torch::zeros({_num_cells, 1}, torch::TensorOptions().dtype(torch::kFloat32).device(_device));
 }
@@ -33,12 +83,53 @@ void TemporalMemory::process(const torch::Tensor& rdr) {
     }
     
     auto prev_activations = _cell_activations.detach();
+    _cell_activations = step(rdr.to(_device), prev_activations);
+}
 
-    auto rdr_on_device = rdr.to(_device);
-    auto weighted_input = torch::matmul(_input_weights, rdr_on_device);
-    auto weighted_recurrent = torch::matmul(_recurrent_weights, prev_activations);
-    
-    _cell_activations = torch::tanh(weighted_input + weighted_recurrent + _bias);
+torch::Tensor TemporalMemory::step(const torch::Tensor& rdr, const torch::Tensor& h) const {
+    if (rdr.size(0) != _rdr_input_size || h.size(0) != _num_cells) {
+        throw std::runtime_error("Input tensors have incorrect size for TemporalMemory::step.");
+    }
+    auto weighted_input = torch::matmul(_input_weights, rdr);
+    auto weighted_recurrent = recurrentProduct(h);
+
+    return torch::tanh(weighted_input + weighted_recurrent + _bias);
+}
+
+torch::Tensor TemporalMemory::forwardSequence(const torch::Tensor& rdrs, const torch::Tensor& h0) const {
+    const int64_t batch_size = h0.size(1);
+    if (rdrs.size(0) != _rdr_input_size || h0.size(0) != _num_cells || rdrs.size(1) % batch_size != 0) {
+        throw std::runtime_error("Input tensors have incorrect size for TemporalMemory::forwardSequence.");
+    }
+    const int64_t steps = rdrs.size(1) / batch_size;
+
+    // Hoisted input projection (plus bias) for every timestep at once.
+    torch::Tensor projected = torch::addmm(_bias, _input_weights, rdrs);
+
+    std::vector<torch::Tensor> states;
+    states.reserve(steps);
+    torch::Tensor h = h0;
+    for (int64_t t = 0; t < steps; ++t) {
+        torch::Tensor input_term = projected.narrow(1, t * batch_size, batch_size);
+        h = (_structure == RecurrentStructure::Dense)
+                ? torch::tanh(torch::addmm(input_term, _recurrent_weights, h))
+                : torch::tanh(input_term + recurrentProduct(h));
+        states.push_back(h);
+    }
+    return torch::cat(states, 1);
+}
+
+torch::Tensor TemporalMemory::processSequence(const torch::Tensor& rdr_matrix) {
+    if (rdr_matrix.size(1) == 0) {
+        return torch::empty({_num_cells, 0}, _cell_activations.options());
+    }
+    torch::Tensor states = forwardSequence(rdr_matrix.to(_device), _cell_activations.detach());
+    _cell_activations = states.narrow(1, states.size(1) - 1, 1);
+    return states;
+}
+
+torch::Tensor TemporalMemory::initialState(int64_t batch_size) const {
+    return torch::zeros({_num_cells, batch_size}, torch::TensorOptions().dtype(torch::kFloat32).device(_device));
 }
 
 const torch::Tensor& TemporalMemory::getPredictiveState() const {
@@ -48,22 +139,61 @@ const torch::Tensor& TemporalMemory::getPredictiveState() const {
 int TemporalMemory::getNumCells() const { return _num_cells; }
 
 void TemporalMemory::save(torch::serialize::OutputArchive& archive) const {
-    archive.write("tm_input_weights", _input_weights.to(torch::kCPU));
-    archive.write("tm_recurrent_weights", _recurrent_weights.to(torch::kCPU));
-    archive.write("tm_bias", _bias.to(torch::kCPU));
+    for (const auto& named : namedTensors()) {
+        archive.write(named.first, named.second.to(torch::kCPU));
+    }
+}
+
+std::vector<std::pair<std::string, torch::Tensor>> TemporalMemory::namedTensors() const {
+    std::vector<std::pair<std::string, torch::Tensor>> tensors = {
+        {"tm_input_weights", _input_weights},
+        {"tm_bias", _bias},
+        {"tm_recurrent_structure",
+         torch::tensor(std::vector<int64_t>{static_cast<int64_t>(_structure), _recurrent_dim})},
+    };
+    if (_structure == RecurrentStructure::LowRank) {
+        tensors.emplace_back("tm_recurrent_u", _recurrent_u);
+        tensors.emplace_back("tm_recurrent_v", _recurrent_v);
+    } else {
+        tensors.emplace_back("tm_recurrent_weights", _recurrent_weights);
+    }
+    return tensors;
 }
 
 void TemporalMemory::load(torch::serialize::InputArchive& archive, torch::Device device) {
     archive.read("tm_input_weights", _input_weights);
-    archive.read("tm_recurrent_weights", _recurrent_weights);
     archive.read("tm_bias", _bias);
+
+    // Models saved before the structure key existed are dense.
+    torch::Tensor structure;
+    if (archive.try_read("tm_recurrent_structure", structure)) {
+        _structure = static_cast<RecurrentStructure>(structure[0].item<int64_t>());
+        _recurrent_dim = static_cast<int>(structure[1].item<int64_t>());
+    } else {
+        _structure = RecurrentStructure::Dense;
+        _recurrent_dim = static_cast<int>(_input_weights.size(0));
+    }
+    _recurrent_weights = torch::Tensor();
+    _recurrent_u = torch::Tensor();
+    _recurrent_v = torch::Tensor();
+    if (_structure == RecurrentStructure::LowRank) {
+        archive.read("tm_recurrent_u", _recurrent_u);
+        archive.read("tm_recurrent_v", _recurrent_v);
+        _recurrent_u = _recurrent_u.to(device).requires_grad_(true);
+        _recurrent_v = _recurrent_v.to(device).requires_grad_(true);
+    } else {
+        archive.read("tm_recurrent_weights", _recurrent_weights);
+        _recurrent_weights = _recurrent_weights.to(device).requires_grad_(true);
+    }
     
     // [SLLM FIX] Use the correct in-place setter function with a trailing underscore.
     _input_weights = _input_weights.to(device).requires_grad_(true);
-    _recurrent_weights = _recurrent_weights.to(device).requires_grad_(true);
     _bias = _bias.to(device).requires_grad_(true);
 }
 
 std::vector<torch::Tensor> TemporalMemory::getParameters() {
+    if (_structure == RecurrentStructure::LowRank) {
+        return {_input_weights, _recurrent_u, _recurrent_v, _bias};
+    }
     return {_input_weights, _recurrent_weights, _bias};
 }
\ No newline at end of file
@@ -4,31 +4,77 @@
 
 #include "types.hpp"
 #include <torch/torch.h>
+#include <string>
+#include <utility>
+#include <vector>
 
 class TemporalMemory {
 public:
+    // How the cell-to-cell recurrence is parameterized. Dense is the full num_cells^2
+    // matrix; LowRank is W = U * V^T with U, V [num_cells, rank]; BlockDiagonal keeps only
+    // num_cells / block_size independent [block_size, block_size] blocks. The last two
+    // cost O(num_cells * rank) and O(num_cells * block_size) per step instead of O(num_cells^2).
+    enum class RecurrentStructure { Dense, LowRank, BlockDiagonal };
+
     TemporalMemory() = default;
-    TemporalMemory(int rdr_input_size, int num_cells, torch::Device device);
+    // `recurrent_dim` is the rank (LowRank) or block size (BlockDiagonal); <= 0 picks a default.
+    TemporalMemory(int rdr_input_size, int num_cells, torch::Device device,
+                   RecurrentStructure structure = RecurrentStructure::Dense, int recurrent_dim = 0);
 
     void process(const torch::Tensor& rdr);
+
+    // Functional recurrence for B parallel streams: rdr is [rdr_size, B], h is
+    // [num_cells, B], returns the next [num_cells, B] state. Unlike process(), the
+    // incoming state is not detached, so gradients flow back through unrolled steps.
+    torch::Tensor step(const torch::Tensor& rdr, const torch::Tensor& h) const;
+    torch::Tensor initialState(int64_t batch_size) const;
+
+    // Runs T steps for B streams as one graph. `rdrs` is [rdr_size, T*B] with column
+    // t*B + b holding stream b's input at step t; h0 is [num_cells, B]. The input
+    // projection of all T*B columns is a single GEMM, and only the recurrent term is
+    // scanned. Returns every state as [num_cells, T*B] in the same column layout.
+    torch::Tensor forwardSequence(const torch::Tensor& rdrs, const torch::Tensor& h0) const;
+
+    // Single-stream form over the internal state: [rdr_size, T] in, [num_cells, T] out.
+    // The last state becomes the predictive state, as if process() had run T times.
+    torch::Tensor processSequence(const torch::Tensor& rdr_matrix);
     void resetStates();
     const torch::Tensor& getPredictiveState() const;
     int getNumCells() const;
+    const torch::Tensor& getInputWeights() const { return _input_weights; }
+    RecurrentStructure getRecurrentStructure() const { return _structure; }
+    int getRecurrentDim() const { return _recurrent_dim; }
+    // Dense: [cells, cells]; BlockDiagonal: [cells / block_size, block_size, block_size].
+    const torch::Tensor& getRecurrentWeights() const { return _recurrent_weights; }
+    // LowRank factors, each [cells, rank].
+    const torch::Tensor& getRecurrentU() const { return _recurrent_u; }
+    const torch::Tensor& getRecurrentV() const { return _recurrent_v; }
+    const torch::Tensor& getBias() const { return _bias; }
     
     // [SLLM ADDED] Methods to save/load all weight tensors
     void save(torch::serialize::OutputArchive& archive) const;
     void load(torch::serialize::InputArchive& archive, torch::Device device);
+    // The tensors save() writes, keyed as in the archive and still on their device.
+    std::vector<std::pair<std::string, torch::Tensor>> namedTensors() const;
 
     // [SLLM ADDED] Collect all parameters for the optimizer
     std::vector<torch::Tensor> getParameters();
 
 private:
+    void initializeRecurrentWeights(const torch::TensorOptions& options);
+    // W_rec * h for a [num_cells, B] state, in whichever structure is configured.
+    torch::Tensor recurrentProduct(const torch::Tensor& h) const;
+
     int _num_cells;
     int _rdr_input_size;
     torch::Device _device;
+    RecurrentStructure _structure = RecurrentStructure::Dense;
+    int _recurrent_dim = 0;
 
     torch::Tensor _input_weights;
-    torch::Tensor _recurrent_weights;
+    torch::Tensor _recurrent_weights; // Dense or BlockDiagonal
+    torch::Tensor _recurrent_u;       // LowRank
+    torch::Tensor _recurrent_v;       // LowRank
     torch::Tensor _bias;
     torch::Tensor _cell_activations;
 };
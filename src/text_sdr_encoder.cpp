@@ -2,9 +2,49 @@
 #include "text_sdr_encoder.hpp"
 #include "sentencepiece_processor.h"
 #include "progress_bar.hpp" 
+#include "fnv_hash.hpp"
+#include <cereal/archives/binary.hpp>
 #include <stdexcept>
+#include <algorithm>
 #include <utility> 
 #include <iostream>
+#include <fstream>
+#include <filesystem>
+
+namespace {
+
+const int kTokenRdseSeed = 42;
+
+// Identifies the RDSE configuration a cached codebook was built from.
+struct CodebookHeader {
+    int format_version = 1;
+    int vocab_size = 0;
+    int sdr_size = 0;
+    int active_bits = 0;
+    int seed = 0;
+
+    bool operator==(const CodebookHeader& other) const {
+        return format_version == other.format_version && vocab_size == other.vocab_size &&
+               sdr_size == other.sdr_size && active_bits == other.active_bits && seed == other.seed;
+    }
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(format_version), CEREAL_NVP(vocab_size), CEREAL_NVP(sdr_size),
+           CEREAL_NVP(active_bits), CEREAL_NVP(seed));
+    }
+};
+
+CodebookHeader makeCodebookHeader(int vocab_size, const RDSEInstance& rdse) {
+    CodebookHeader header;
+    header.vocab_size = vocab_size;
+    header.sdr_size = rdse.size;
+    header.active_bits = rdse.active_bits;
+    header.seed = kTokenRdseSeed;
+    return header;
+}
+
+} // namespace
 
 TextSdrEncoder::TextSdrEncoder() = default;
 
@@ -15,7 +55,15 @@ TextSdrEncoder::TextSdrEncoder(const std::string& tokenizer_model_path, int sdr_
         throw std::runtime_error("Failed to load SentencePiece model: " + status.ToString());
     }
     
-    token_rdse_ = create_rdse(sdr_size, sdr_active_bits, sp_processor_->GetPieceSize(), 42);
+    token_rdse_ = create_rdse(sdr_size, sdr_active_bits, sp_processor_->GetPieceSize(), kTokenRdseSeed);
+
+    // The codebook lives next to the tokenizer (e.g. tokenizer.model -> tokenizer.codebook).
+    const std::string codebook_path =
+        std::filesystem::path(tokenizer_model_path).replace_extension(".codebook").string();
+    if (!loadCodebook(codebook_path)) {
+        buildCodebook();
+        saveCodebook(codebook_path);
+    }
 }
 
 TextSdrEncoder::~TextSdrEncoder() = default;
@@ -42,7 +90,77 @@ std::vector<SDR> TextSdrEncoder::encode(const std::string& text) {
 }
 
 SDR TextSdrEncoder::encodeSingleToken(int token_id) {
-    return encode_scalar(token_rdse_, static_cast<double>(token_id));
+    if (token_id < 0 || token_id >= static_cast<int>(token_codebook_.size())) {
+        return encode_scalar(token_rdse_, static_cast<double>(token_id));
+    }
+    return token_codebook_[token_id].toDense();
+}
+
+const SparseSdr& TextSdrEncoder::encodeSingleTokenSparse(int token_id) const {
+    if (token_id < 0 || token_id >= static_cast<int>(token_codebook_.size())) {
+        throw std::out_of_range("Token id " + std::to_string(token_id) + " is outside the SDR codebook.");
+    }
+    return token_codebook_[token_id];
+}
+
+int TextSdrEncoder::getSdrSize() const {
+    return token_rdse_.size;
+}
+
+uint64_t TextSdrEncoder::configHash() const {
+    Fnv1a64 hash;
+    hash.updateValue(token_rdse_.size);
+    hash.updateValue(static_cast<uint64_t>(token_codebook_.size()));
+    for (const auto& sdr : token_codebook_) {
+        hash.updateVector(sdr.active);
+    }
+    return hash.digest();
+}
+
+void TextSdrEncoder::buildCodebook() {
+    const int vocab_size = getVocabSize();
+    token_codebook_.assign(vocab_size, {});
+    for (int id = 0; id < vocab_size; ++id) {
+        SparseSdr& entry = token_codebook_[id];
+        entry.size = token_rdse_.size;
+        encode_scalar_indices(token_rdse_, static_cast<double>(id), entry.active);
+        std::sort(entry.active.begin(), entry.active.end());
+    }
+}
+
+bool TextSdrEncoder::loadCodebook(const std::string& path) {
+    std::ifstream is(path, std::ios::binary);
+    if (!is) return false;
+
+    const CodebookHeader expected = makeCodebookHeader(getVocabSize(), token_rdse_);
+    try {
+        cereal::BinaryInputArchive archive(is);
+        CodebookHeader header;
+        archive(header);
+        if (!(header == expected)) {
+            std::cout << "Token SDR codebook at " << path << " is stale; rebuilding." << std::endl;
+            return false;
+        }
+        std::vector<SparseSdr> codebook;
+        archive(codebook);
+        if (static_cast<int>(codebook.size()) != expected.vocab_size) return false;
+        token_codebook_ = std::move(codebook);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: could not read token SDR codebook " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void TextSdrEncoder::saveCodebook(const std::string& path) const {
+    std::ofstream os(path, std::ios::binary);
+    if (!os) {
+        std::cerr << "Warning: could not write token SDR codebook to " << path << std::endl;
+        return;
+    }
+    const CodebookHeader header = makeCodebookHeader(getVocabSize(), token_rdse_);
+    cereal::BinaryOutputArchive archive(os);
+    archive(header, token_codebook_);
 }
 
 std::string TextSdrEncoder::decode(const std::vector<int>& ids) const {
@@ -66,4 +184,26 @@ int TextSdrEncoder::getVocabSize() const {
 std::string TextSdrEncoder::idToPiece(int id) const {
     if (!sp_processor_) return "";
     return sp_processor_->IdToPiece(id);
+}
+
+std::string TextSdrEncoder::pieceText(int id) const {
+    if (!sp_processor_ || id < 0 || id >= getVocabSize()) return "";
+    if (sp_processor_->IsControl(id) || sp_processor_->IsUnknown(id)) return "";
+    const std::string& piece = sp_processor_->IdToPiece(id);
+    if (sp_processor_->IsByte(id)) {
+        // Byte-fallback pieces are spelled "<0xHH>".
+        return std::string(1, static_cast<char>(std::stoi(piece.substr(3, 2), nullptr, 16)));
+    }
+    const std::string sp_space = "\xE2\x96\x81";
+    std::string text;
+    text.reserve(piece.size());
+    for (size_t pos = 0; pos < piece.size();) {
+        if (piece.compare(pos, sp_space.size(), sp_space) == 0) {
+            text += ' ';
+            pos += sp_space.size();
+        } else {
+            text += piece[pos++];
+        }
+    }
+    return text;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #define TEXT_SDR_ENCODER_HPP
 
 #include "rdse.hpp"
+#include "sparse_sdr.hpp"
 #include <Eigen/Dense>
 #include <string>
 #include <vector>
@@ -28,9 +29,15 @@ public:
     // This method now just calls tokenize and then loops through encodeSingleToken
     std::vector<SDR> encode(const std::string& text);
     
-    // The core function to encode one token
+    // The core function to encode one token, served from the precomputed codebook
     SDR encodeSingleToken(int token_id);
 
+    // Sparse form of a token's SDR, read straight from the codebook
+    const SparseSdr& encodeSingleTokenSparse(int token_id) const;
+    int getSdrSize() const;
+    // Fingerprint of the token -> SDR mapping (the whole codebook).
+    uint64_t configHash() const;
+
     // New function to get token IDs, allowing the progress bar to be external
     std::vector<int> tokenize(const std::string& text) const;
 
@@ -39,9 +46,19 @@ public:
 
     int getVocabSize() const;
     std::string idToPiece(int id) const;
+    // The text `id` contributes to a decoded string: "\u2581" becomes a space, a byte-fallback
+    // piece its raw byte, and control and unknown pieces nothing. Lets callers detokenize
+    // one token at a time.
+    std::string pieceText(int id) const;
 
 private:
+    // Builds the token -> active-indices codebook for the whole vocabulary.
+    void buildCodebook();
+    bool loadCodebook(const std::string& path);
+    void saveCodebook(const std::string& path) const;
+
     RDSEInstance token_rdse_;
+    std::vector<SparseSdr> token_codebook_;
     std::unique_ptr<sentencepiece::SentencePieceProcessor> sp_processor_;
 };
 
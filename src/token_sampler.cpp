@@ -0,0 +1,108 @@
+// src/token_sampler.cpp
+#include "token_sampler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Orders the heap with the worst candidate on top: lower logit, or the higher id on a tie,
+// so equal logits keep the lower id (as selectTopK does).
+bool betterCandidate(const std::pair<float, int>& a, const std::pair<float, int>& b) {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+} // namespace
+
+TokenSampler::TokenSampler(int vocab_size, const EmotionConfig& config)
+    : vocab_size_(vocab_size),
+      top_k_(config.top_k > 0 && config.top_k < vocab_size ? config.top_k : vocab_size),
+      temperature_(config.temp),
+      repetition_penalty_(config.repetition_penalty),
+      history_(std::max(config.repetition_lookback, 0)),
+      occurrences_(vocab_size, 0),
+      banned_(vocab_size, 0) {
+    if (vocab_size <= 0) {
+        throw std::invalid_argument("TokenSampler needs a positive vocabulary size.");
+    }
+    heap_.reserve(top_k_);
+    weights_.resize(top_k_);
+    seed(config.seed);
+}
+
+void TokenSampler::seed(long long seed) {
+    rng_.seed(seed < 0 ? std::random_device{}() : static_cast<uint64_t>(seed));
+}
+
+void TokenSampler::record(int token_id) {
+    if (history_.empty() || token_id < 0 || token_id >= vocab_size_) return;
+    if (history_size_ == static_cast<int>(history_.size())) {
+        --occurrences_[history_[history_head_]];
+    } else {
+        ++history_size_;
+    }
+    history_[history_head_] = token_id;
+    ++occurrences_[token_id];
+    history_head_ = (history_head_ + 1) % static_cast<int>(history_.size());
+}
+
+void TokenSampler::clearHistory() {
+    std::fill(occurrences_.begin(), occurrences_.end(), 0);
+    history_head_ = 0;
+    history_size_ = 0;
+}
+
+int TokenSampler::sample(const float* logits, const std::vector<int>& banned_tokens) {
+    for (int token_id : banned_tokens) {
+        if (token_id >= 0 && token_id < vocab_size_) banned_[token_id] = 1;
+    }
+
+    const bool penalize = repetition_penalty_ != 1.0f && history_size_ > 0;
+    heap_.clear();
+    for (int i = 0; i < vocab_size_; ++i) {
+        if (banned_[i]) continue;
+        float logit = logits[i];
+        if (penalize && occurrences_[i] > 0) {
+            logit = logit > 0.0f ? logit / repetition_penalty_ : logit * repetition_penalty_;
+        }
+        if (!(logit > -std::numeric_limits<float>::infinity())) continue; // Also drops NaN
+
+        const std::pair<float, int> candidate(logit, i);
+        if (static_cast<int>(heap_.size()) < top_k_) {
+            heap_.push_back(candidate);
+            std::push_heap(heap_.begin(), heap_.end(), betterCandidate);
+        } else if (betterCandidate(candidate, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), betterCandidate);
+            heap_.back() = candidate;
+            std::push_heap(heap_.begin(), heap_.end(), betterCandidate);
+        }
+    }
+
+    for (int token_id : banned_tokens) {
+        if (token_id >= 0 && token_id < vocab_size_) banned_[token_id] = 0;
+    }
+    if (heap_.empty()) return -1;
+
+    const int count = static_cast<int>(heap_.size());
+    int best = 0;
+    for (int c = 1; c < count; ++c) {
+        if (betterCandidate(heap_[c], heap_[best])) best = c;
+    }
+    if (!(temperature_ > 0.0f)) return heap_[best].second;
+
+    // softmax(logit / T) over the candidates, then an inverse-CDF draw.
+    const float max_logit = heap_[best].first;
+    float total = 0.0f;
+    for (int c = 0; c < count; ++c) {
+        weights_[c] = std::exp((heap_[c].first - max_logit) / temperature_);
+        total += weights_[c];
+    }
+    std::uniform_real_distribution<float> uniform(0.0f, total);
+    float draw = uniform(rng_);
+    for (int c = 0; c < count; ++c) {
+        draw -= weights_[c];
+        if (draw < 0.0f) return heap_[c].second;
+    }
+    return heap_[best].second;
+}
@@ -0,0 +1,58 @@
+// src/token_sampler.hpp
+#ifndef TOKEN_SAMPLER_HPP
+#define TOKEN_SAMPLER_HPP
+
+#include "emotion.hpp"
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Picks the next token from a row of logits in one pass, without allocating.
+ *
+ * The sweep over the vocabulary skips banned ids, applies the repetition penalty to ids
+ * in the recent-history window, and keeps the top_k best in a small min-heap. Softmax
+ * with temperature and an inverse-CDF draw then run over those k candidates only.
+ *
+ * The penalty follows the usual convention: a positive logit is divided by the penalty
+ * and a negative one multiplied by it. The window is a ring buffer of the last
+ * `repetition_lookback` recorded ids. Per-id occurrence counts are updated as ids enter
+ * and leave it, so checking an id during the sweep costs O(1).
+ *
+ * All buffers are sized for the vocabulary at construction. A fixed seed makes the draws
+ * reproducible.
+ */
+class TokenSampler {
+public:
+    TokenSampler(int vocab_size, const EmotionConfig& config);
+
+    // Samples from `logits` (vocab_size values). Returns -1 when every id is banned.
+    // temperature <= 0 picks the best candidate.
+    int sample(const float* logits, const std::vector<int>& banned_tokens);
+
+    // Adds a generated id to the repetition window, evicting the oldest when it is full.
+    void record(int token_id);
+    void clearHistory();
+
+    // Restarts the random stream; a negative seed draws one from std::random_device.
+    void seed(long long seed);
+
+private:
+    int vocab_size_;
+    int top_k_;
+    float temperature_;
+    float repetition_penalty_;
+    std::mt19937_64 rng_;
+
+    std::vector<int> history_; // Ring buffer, capacity repetition_lookback
+    int history_head_ = 0;
+    int history_size_ = 0;
+    std::vector<int> occurrences_;    // Per id: how often it is in the window
+    std::vector<uint8_t> banned_;
+
+    std::vector<std::pair<float, int>> heap_; // (adjusted logit, id), worst on top
+    std::vector<float> weights_;
+};
+
+#endif // TOKEN_SAMPLER_HPP
@@ -0,0 +1,58 @@
+// src/top_k.hpp
+#ifndef TOP_K_HPP
+#define TOP_K_HPP
+
+/**
+ * @brief Selects the k largest values that are strictly above `threshold`.
+ *
+ * A single pass that keeps the current winners in a small sorted buffer, so
+ * there is no allocation and no sort over the candidates. Winners come out
+ * largest first, ties broken towards the lower index -- the same order as
+ * sorting (-value, index) pairs.
+ *
+ * @param values The scores to select from.
+ * @param n The number of scores.
+ * @param k The maximum number of winners.
+ * @param threshold Only values > threshold are eligible.
+ * @param out_indices Receives the winning indices; must have room for k entries.
+ * @return The number of winners written (at most k).
+ */
+template <typename T>
+int selectTopK(const T* values, int n, int k, T threshold, int* out_indices) {
+    if (k <= 0) return 0;
+    int count = 0;
+    for (int i = 0; i < n; ++i) {
+        const T v = values[i];
+        if (!(v > threshold)) continue;
+        if (count == k && !(v > values[out_indices[k - 1]])) continue;
+
+        // Shift smaller winners down; earlier equal values keep their place.
+        int pos = (count < k) ? count++ : k - 1;
+        while (pos > 0 && v > values[out_indices[pos - 1]]) {
+            out_indices[pos] = out_indices[pos - 1];
+            --pos;
+        }
+        out_indices[pos] = i;
+    }
+    return count;
+}
+
+/**
+ * @brief Batched form of selectTopK over the rows of a row-major matrix.
+ *
+ * Rows are independent and are processed in parallel when OpenMP is enabled.
+ *
+ * @param values Row-major scores, `rows` x `n`.
+ * @param out_indices Row-major winners, `rows` x `k`.
+ * @param out_counts Receives the number of winners of each row.
+ */
+template <typename T>
+void selectTopKRows(const T* values, int rows, int n, int k, T threshold, int* out_indices, int* out_counts) {
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < rows; ++r) {
+        out_counts[r] = selectTopK(values + static_cast<long long>(r) * n, n, k, threshold,
+                                   out_indices + static_cast<long long>(r) * k);
+    }
+}
+
+#endif // TOP_K_HPP
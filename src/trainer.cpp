@@ -7,66 +7,384 @@
 #include "grid_cell_encoder.hpp"
 #include "progress_bar.hpp"
 #include "text_sdr_encoder.hpp"
+#include "inference_engine.hpp"
+#include "basis_prefetcher.hpp"
+#include "basis_cache.hpp"
+#include "fnv_hash.hpp"
+#include "checkpoint.hpp"
+#include "sparse_column_adam.hpp"
+#include "unigram_sampler.hpp"
 
 #include <torch/torch.h>
 #include <iostream>
 #include <iomanip>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <memory>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+
+// Basis SDRs (frozen SP winners) of the given corpus positions: read from `cache` when it is
+// open, otherwise computed by encoding (token_ids[i], position {i, i}) and running the SP.
+static std::vector<SparseSdr> basis_sdrs_for(const std::vector<size_t>& positions, const std::vector<int>& token_ids,
+                                             const SpatialPooler& sp, const TextSdrEncoder& encoder,
+                                             const GridCellEncoder& position_encoder, const BasisCache* cache) {
+    if (cache && cache->isOpen()) {
+        std::vector<SparseSdr> basis_sdrs(positions.size());
+        for (size_t p = 0; p < positions.size(); ++p) {
+            cache->get(positions[p], basis_sdrs[p]);
+        }
+        return basis_sdrs;
+    }
+
+    std::vector<SparseSdr> position_sdrs(positions.size());
+    std::vector<ConcatenatedSdr> input_sdrs(positions.size());
+    std::vector<double> coordinates(2);
+    for (size_t p = 0; p < positions.size(); ++p) {
+        const size_t i = positions[p];
+        coordinates[0] = coordinates[1] = static_cast<double>(i);
+        position_encoder.encodeSparse(coordinates, position_sdrs[p]);
+        input_sdrs[p].append(encoder.encodeSingleTokenSparse(token_ids[i]));
+        input_sdrs[p].append(position_sdrs[p]);
+    }
+    return sp.inferBatch(input_sdrs);
+}
+
+// Maps (building it on first use) the basis-SDR cache of every position of `token_ids`. The
+// key covers the SP state, both encoders and the tokens, so any change rebuilds the file.
+static BasisCache open_basis_cache(const std::string& path, const std::vector<int>& token_ids, const SpatialPooler& sp,
+                                   const TextSdrEncoder& encoder, const GridCellEncoder& position_encoder) {
+    Fnv1a64 hash;
+    hash.updateValue(sp.stateHash());
+    hash.updateValue(encoder.configHash());
+    hash.updateValue(position_encoder.configHash());
+    hash.updateVector(token_ids);
+
+    std::unique_ptr<ProgressBar> build_bar;
+    std::vector<size_t> positions;
+    auto build_block = [&](size_t begin, size_t end, std::vector<SparseSdr>& out) {
+        if (!build_bar) build_bar = std::make_unique<ProgressBar>(token_ids.size(), "  Caching basis SDRs");
+        positions.resize(end - begin);
+        for (size_t i = begin; i < end; ++i) positions[i - begin] = i;
+        out = basis_sdrs_for(positions, token_ids, sp, encoder, position_encoder, nullptr);
+        build_bar->update(end);
+    };
+    BasisCache cache = BasisCache::openOrBuild(path, hash.digest(), sp.getNumColumns(), sp.getNumActiveColumns(),
+                                               token_ids.size(), build_block);
+    if (build_bar) {
+        build_bar->done();
+    } else {
+        std::cout << "Using basis cache " << path << " (" << cache.size() << " positions)." << std::endl;
+    }
+    return cache;
+}
+
+EvaluationResult evaluate_model_detailed(DaoModel &model, TextSdrEncoder &encoder, const std::vector<int> &validation_token_ids, torch::Device device, const EvaluationConfig &config, bool verbose, const BasisCache* basis_cache) {
+    EvaluationResult result;
+    if (model.spatial_poolers.empty()) return result;
+    const long long total_predictions = static_cast<long long>(validation_token_ids.size()) - 1;
+    if (total_predictions <= 0) return result;
 
-// evaluate_model is unchanged ...
-double evaluate_model(DaoModel &model, TextSdrEncoder &encoder, const std::vector<int> &validation_token_ids, torch::Device device, bool verbose) {
-    if (model.spatial_poolers.empty()) return 0.0;
-    
     torch::NoGradGuard no_grad;
-    for (auto& tm : model.temporal_memories) tm.resetStates();
 
     const int position_sdr_size = 2048;
     GridCellEncoder position_encoder(position_sdr_size, static_cast<int>(position_sdr_size * 0.02));
     position_encoder.addModule(50.0, 101);
-    
-    int correct_predictions = 0;
-    int total_predictions = validation_token_ids.size() - 1;
-    if (total_predictions <= 0) return 0.0;
 
-    ProgressBar eval_bar(total_predictions, "  Evaluating");
+    SpatialPooler& sp = model.spatial_poolers[0];
+    ResonanceLayer& rl = model.resonance_layers[0];
+    TemporalMemory& tm = model.temporal_memories[0];
 
-    for (size_t i = 0; i < validation_token_ids.size() - 1; ++i) {
-        int current_token_id = validation_token_ids[i];
-        int actual_next_token_id = validation_token_ids[i + 1];
+    // Shard s scores predictions [s*L, (s+1)*L) and is fed from `warmup` tokens earlier, so its
+    // state has some context when scoring starts. All shards advance together as one batch
+    // (column t*B + b, as in training). With one shard this is the exact sequential protocol.
+    const int shards = static_cast<int>(std::min<long long>(std::max(config.shards, 1), total_predictions));
+    const long long shard_length = (total_predictions + shards - 1) / shards;
+    const long long warmup = shards > 1 ? std::max(config.warmup_tokens, 0) : 0;
+    const long long stream_steps = shard_length + warmup;
+    std::vector<long long> stream_begin(shards), score_begin(shards), score_end(shards);
+    for (int s = 0; s < shards; ++s) {
+        score_begin[s] = s * shard_length;
+        score_end[s] = std::min(total_predictions, score_begin[s] + shard_length);
+        stream_begin[s] = std::max(0LL, score_begin[s] - warmup);
+    }
+    const int top_k = static_cast<int>(std::min<int64_t>(std::max(config.top_k, 1), model.vocab_matrix.size(0)));
+
+    auto device_options = torch::TensorOptions().device(device);
+    torch::Tensor top1_correct = torch::zeros({}, device_options.dtype(torch::kLong));
+    torch::Tensor topk_correct = torch::zeros({}, device_options.dtype(torch::kLong));
+    torch::Tensor nll_sum = torch::zeros({}, device_options.dtype(torch::kDouble));
+    torch::Tensor hidden = tm.initialState(shards);
 
-        torch::Tensor predictive_state = model.temporal_memories[0].getPredictiveState();
-        torch::Tensor logits = torch::matmul(model.vocab_matrix, predictive_state).squeeze();
-        auto prediction = torch::argmax(logits).item<int>();
+    ProgressBar eval_bar(stream_steps * shards, "  Evaluating");
 
-        if (prediction == actual_next_token_id) {
-            correct_predictions++;
+    // The prediction for token i + 1 is read from the state before token i is fed, i.e. the
+    // previous state. Steps past the end of the data are fed but not scored.
+    const long long chunk_steps = std::max<long long>(1, 256 / shards);
+    std::vector<size_t> positions;
+    std::vector<int64_t> scored_columns;
+    std::vector<int64_t> targets;
+
+    for (long long chunk_start = 0; chunk_start < stream_steps; chunk_start += chunk_steps) {
+        const long long steps = std::min(chunk_steps, stream_steps - chunk_start);
+        positions.clear();
+        scored_columns.clear();
+        targets.clear();
+        for (long long t = 0; t < steps; ++t) {
+            for (int b = 0; b < shards; ++b) {
+                const long long i = stream_begin[b] + chunk_start + t;
+                positions.push_back(static_cast<size_t>(std::min(i, total_predictions - 1)));
+                if (i >= score_begin[b] && i < score_end[b]) {
+                    scored_columns.push_back(t * shards + b);
+                    targets.push_back(validation_token_ids[i + 1]);
+                }
+            }
         }
 
-        SDR token_sdr = encoder.encodeSingleToken(current_token_id);
-        std::vector<double> coordinates = {static_cast<double>(i), static_cast<double>(i)};
-        SDR position_sdr = position_encoder.encode(coordinates);
-        SDR concatenated_sdr = token_sdr;
-        concatenated_sdr.insert(concatenated_sdr.end(), position_sdr.begin(), position_sdr.end());
-        
-        SDR basis_sdr = model.spatial_poolers[0].process(concatenated_sdr, false);
-        torch::Tensor rdr = model.resonance_layers[0].process(basis_sdr);
-        model.temporal_memories[0].process(rdr);
-        
-        eval_bar.update(i + 1);
+        std::vector<SparseSdr> basis_sdrs =
+            basis_sdrs_for(positions, validation_token_ids, sp, encoder, position_encoder, basis_cache);
+        torch::Tensor states = tm.forwardSequence(rl.processBatch(basis_sdrs), hidden);
+        torch::Tensor predictive_states = torch::cat({hidden, states.narrow(1, 0, (steps - 1) * shards)}, 1);
+        hidden = states.narrow(1, (steps - 1) * shards, shards);
+
+        if (!scored_columns.empty()) {
+            auto long_options = torch::TensorOptions().dtype(torch::kLong);
+            torch::Tensor columns = torch::tensor(scored_columns, long_options).to(device);
+            torch::Tensor target = torch::tensor(targets, long_options).to(device);
+            torch::Tensor logits = torch::matmul(model.vocab_matrix, predictive_states.index_select(1, columns)).t(); // [n, V]
+
+            top1_correct += torch::argmax(logits, 1).eq(target).sum();
+            torch::Tensor top_indices = std::get<1>(torch::topk(logits, top_k, 1));
+            topk_correct += top_indices.eq(target.unsqueeze(1)).any(1).sum();
+            // Perplexity of the distribution the model is trained on (logits clamped as in train_model).
+            torch::Tensor log_probs = torch::log_softmax(torch::clamp(logits, -15.0f, 15.0f), 1);
+            nll_sum -= log_probs.gather(1, target.unsqueeze(1)).sum().to(torch::kDouble);
+        }
+        eval_bar.update((chunk_start + steps) * shards);
     }
     eval_bar.done();
-    
-    double accuracy = (total_predictions > 0) ? (static_cast<double>(correct_predictions) / total_predictions) * 100.0 : 0.0; 
+
+    // One host sync for all three totals.
+    torch::Tensor totals = torch::stack({top1_correct.to(torch::kDouble), topk_correct.to(torch::kDouble), nll_sum}).cpu();
+    const double* total_values = totals.data_ptr<double>();
+    result.predictions = total_predictions;
+    result.top1_correct = static_cast<long long>(total_values[0]);
+    result.top1_accuracy = total_values[0] / total_predictions * 100.0;
+    result.topk_accuracy = total_values[1] / total_predictions * 100.0;
+    result.perplexity = std::exp(total_values[2] / total_predictions);
+
     if (verbose) {
-        std::cout << "\n--- Validation Results ---" << std::endl;
-        std::cout << "   - Correct Predictions: " << correct_predictions << " / " << total_predictions << std::endl;
-        std::cout << "   - Top-1 Accuracy:      " << std::fixed << std::setprecision(2) << accuracy << "%" << std::endl;
+        std::cout << "\n--- Validation Results ";
+        if (shards > 1) {
+            std::cout << "(" << shards << " shards, " << warmup << " warm-up tokens) ";
+        } else {
+            std::cout << "(exact) ";
+        }
+        std::cout << "---" << std::endl;
+        std::cout << "   - Correct Predictions: " << result.top1_correct << " / " << total_predictions << std::endl;
+        std::cout << "   - Top-1 Accuracy:      " << std::fixed << std::setprecision(2) << result.top1_accuracy << "%" << std::endl;
+        std::cout << "   - Top-" << top_k << " Accuracy:      " << std::fixed << std::setprecision(2) << result.topk_accuracy << "%" << std::endl;
+        std::cout << "   - Perplexity:          " << std::fixed << std::setprecision(2) << result.perplexity << std::endl;
     }
-    
-    return accuracy;
+    return result;
+}
+
+double evaluate_model(DaoModel &model, TextSdrEncoder &encoder, const std::vector<int> &validation_token_ids, torch::Device device, bool verbose, const BasisCache* basis_cache) {
+    return evaluate_model_detailed(model, encoder, validation_token_ids, device, EvaluationConfig(), verbose, basis_cache).top1_accuracy;
 }
 
-void train_model(DaoModel &model, TextSdrEncoder &encoder, const std::vector<int> &corpus_token_ids, const std::vector<int> &validation_token_ids) {
+// Same protocol as evaluate_model (the prediction for token i + 1 is read before token i
+// is fed), run token by token through the engine.
+static double evaluate_engine(InferenceEngine& engine, const std::vector<int>& validation_token_ids) {
+    const int total_predictions = static_cast<int>(validation_token_ids.size()) - 1;
+    if (total_predictions <= 0) return 0.0;
+
+    InferenceEngine::Workspace workspace = engine.createWorkspace();
+    engine.reset(workspace, -1.0); // evaluate_model encodes token i at position i
+    int correct_predictions = 0;
+    ProgressBar eval_bar(total_predictions, std::string("  Evaluating ") + toString(engine.getPrecision()));
+    for (int i = 0; i < total_predictions; ++i) {
+        const VectorXf& logits = engine.computeLogits(workspace);
+        Eigen::Index predicted = 0;
+        logits.maxCoeff(&predicted);
+        if (predicted == validation_token_ids[i + 1]) ++correct_predictions;
+        engine.feed(validation_token_ids[i], workspace);
+        if (i % 256 == 0) eval_bar.update(i);
+    }
+    eval_bar.update(total_predictions);
+    eval_bar.done();
+    return static_cast<double>(correct_predictions) / total_predictions * 100.0;
+}
+
+void report_quantization_accuracy(DaoModel &model, TextSdrEncoder &encoder, const std::vector<int> &validation_token_ids, double baseline_accuracy) {
+    if (model.spatial_poolers.empty() || validation_token_ids.size() < 2) return;
+    torch::Device device = model.vocab_matrix.device();
+    const double baseline = baseline_accuracy >= 0.0
+        ? baseline_accuracy
+        : evaluate_model(model, encoder, validation_token_ids, device, false);
+
+    const int position_sdr_size = 2048;
+    GridCellEncoder position_encoder(position_sdr_size, static_cast<int>(position_sdr_size * 0.02));
+    position_encoder.addModule(50.0, 101);
+
+    std::cout << "\n--- Quantized Inference Accuracy ---" << std::endl;
+    std::cout << "   - evaluate_model (fp32): " << std::fixed << std::setprecision(2) << baseline << "%" << std::endl;
+    for (WeightPrecision precision : {WeightPrecision::Float32, WeightPrecision::BFloat16, WeightPrecision::Int8}) {
+        InferenceEngine engine(encoder, position_encoder, model.spatial_poolers[0], model.resonance_layers[0],
+                               model.temporal_memories[0], model.vocab_matrix, precision);
+        const double accuracy = evaluate_engine(engine, validation_token_ids);
+        std::cout << "   - Engine " << toString(precision) << ": " << std::fixed << std::setprecision(2) << accuracy
+                  << "% (delta " << std::showpos << accuracy - baseline << std::noshowpos << " pts), weights "
+                  << std::setprecision(1) << engine.getWeightBytes() / (1024.0 * 1024.0) << " MiB" << std::endl;
+    }
+}
+
+// The totals read back from the device-side accumulators in train_model.
+struct TrainingMetrics {
+    double loss_sum = 0.0;
+    long long tokens = 0;
+    long long skipped = 0;
+
+    // One host sync for all three values.
+    void read(const torch::Tensor& loss_total, const torch::Tensor& token_total, const torch::Tensor& skipped_total) {
+        torch::Tensor packed = torch::stack({loss_total, token_total.to(torch::kDouble), skipped_total.to(torch::kDouble)}).cpu();
+        const double* values = packed.data_ptr<double>();
+        loss_sum = values[0];
+        tokens = static_cast<long long>(values[1]);
+        skipped = static_cast<long long>(values[2]);
+    }
+};
+
+// Same computation as torch::nn::utils::clip_grad_norm_, minus its final norm.item()
+// host sync: the clip coefficient is applied as a device tensor clamped to 1.
+static void clip_grad_norm_on_device(const std::vector<torch::Tensor>& parameters, double max_norm) {
+    std::vector<torch::Tensor> norms;
+    for (const auto& parameter : parameters) {
+        if (parameter.grad().defined()) norms.push_back(parameter.grad().norm());
+    }
+    if (norms.empty()) return;
+    torch::Tensor total_norm = torch::stack(norms).norm();
+    torch::Tensor clip_coef = (max_norm / (total_norm + 1e-6)).clamp_max(1.0);
+    for (const auto& parameter : parameters) {
+        if (parameter.grad().defined()) parameter.grad().mul_(clip_coef);
+    }
+}
+
+// The update of optimizer.step() (Adam without weight decay or amsgrad), with `finite` folded
+// into it: the moments move by lerp weights and the parameters by a step size that are all
+// scaled by the 0/1 flag, so a skipped chunk leaves both exactly as they were, without a host
+// sync or any copy of the weights. `optimizer` only holds the per-parameter state and options.
+// The step counters live on the host and are corrected later by discount_adam_steps, once the
+// skip count has been read back anyway.
+static void masked_adam_step(torch::optim::Adam& optimizer, const std::vector<torch::Tensor>& parameters,
+                             const torch::Tensor& finite) {
+    torch::NoGradGuard no_grad;
+    const auto& options = static_cast<const torch::optim::AdamOptions&>(optimizer.param_groups()[0].options());
+    const double learning_rate = options.lr();
+    const double beta1 = std::get<0>(options.betas());
+    const double beta2 = std::get<1>(options.betas());
+    const double eps = options.eps();
+    const torch::Tensor apply = finite.to(torch::kFloat);
+    const torch::Tensor exp_avg_weight = apply * (1.0 - beta1);
+    const torch::Tensor exp_avg_sq_weight = apply * (1.0 - beta2);
+
+    for (const auto& parameter : parameters) {
+        const torch::Tensor& grad = parameter.grad();
+        if (!grad.defined()) continue;
+        auto& slot = optimizer.state()[parameter.unsafeGetTensorImpl()];
+        if (!slot) {
+            auto created = std::make_unique<torch::optim::AdamParamState>();
+            created->step(0);
+            created->exp_avg(torch::zeros_like(parameter));
+            created->exp_avg_sq(torch::zeros_like(parameter));
+            slot = std::move(created);
+        }
+        auto& state = static_cast<torch::optim::AdamParamState&>(*slot);
+        state.step(state.step() + 1);
+        const double bias_correction1 = 1.0 - std::pow(beta1, static_cast<double>(state.step()));
+        const double bias_correction2 = 1.0 - std::pow(beta2, static_cast<double>(state.step()));
+
+        // m += w * (g - m) is Adam's m = beta1 * m + (1 - beta1) * g when w = 1 - beta1, and no-op when w = 0.
+        state.exp_avg().lerp_(grad, exp_avg_weight);
+        state.exp_avg_sq().lerp_(grad * grad, exp_avg_sq_weight);
+        torch::Tensor denom = state.exp_avg_sq().sqrt().div_(std::sqrt(bias_correction2)).add_(eps);
+        torch::Tensor target = parameter;
+        target.sub_(state.exp_avg() / denom * (apply * (learning_rate / bias_correction1)));
+    }
+}
+
+// Takes `skipped` masked steps back out of every Adam step counter so bias correction
+// counts only the chunks that were applied.
+static void discount_adam_steps(torch::optim::Adam& optimizer, long long skipped) {
+    if (skipped <= 0) return;
+    for (auto& entry : optimizer.state()) {
+        auto& state = static_cast<torch::optim::AdamParamState&>(*entry.second);
+        state.step(std::max<int64_t>(state.step() - skipped, 0));
+    }
+}
+
+// Sampled softmax over the chunk's shared negatives: each row scores its target against
+// `negatives`, both corrected by the log expected sample count (logQ), with negatives that
+// happen to equal the row's target masked out. Logits are clamped as in the full-softmax path.
+// `target` and `negatives` index the rows of `vocab_matrix` and `log_expected_count`, which may
+// be the full vocabulary or just the rows gathered for the chunk.
+static torch::Tensor sampled_softmax_loss(const torch::Tensor& vocab_matrix, const torch::Tensor& states,
+                                          const torch::Tensor& target, const torch::Tensor& negatives,
+                                          const torch::Tensor& log_expected_count,
+                                          torch::nn::CrossEntropyLoss& criterion) {
+    torch::Tensor hidden = states.t();                                                // [N, cells]
+    torch::Tensor true_logits = (vocab_matrix.index_select(0, target) * hidden).sum(1, /*keepdim=*/true);
+    torch::Tensor negative_logits = torch::matmul(hidden, vocab_matrix.index_select(0, negatives).t()); // [N, S]
+    true_logits = torch::clamp(true_logits, -15.0f, 15.0f) - log_expected_count.index_select(0, target).unsqueeze(1);
+    negative_logits = torch::clamp(negative_logits, -15.0f, 15.0f) - log_expected_count.index_select(0, negatives).unsqueeze(0);
+    negative_logits = negative_logits.masked_fill(negatives.unsqueeze(0).eq(target.unsqueeze(1)),
+                                                  -std::numeric_limits<float>::infinity());
+
+    // The true class is column 0 of every row.
+    torch::Tensor logits = torch::cat({true_logits, negative_logits}, 1);
+    return criterion(logits, torch::zeros_like(target));
+}
+
+// Fingerprint of everything a checkpoint's position and optimizer state depend on: the corpus,
+// the vocabulary, the mini-batch layout, the recurrent structure and which weights the dense
+// and lazy optimizers own.
+static uint64_t training_fingerprint(const std::vector<int>& corpus_token_ids, const TextSdrEncoder& encoder,
+                                     int batch_size, size_t bptt_steps, const TrainingConfig& config) {
+    Fnv1a64 hash;
+    hash.updateVector(corpus_token_ids);
+    hash.updateValue(encoder.configHash());
+    hash.updateValue(static_cast<int64_t>(batch_size));
+    hash.updateValue(static_cast<uint64_t>(bptt_steps));
+    hash.updateValue(static_cast<int64_t>(config.recurrent_structure));
+    hash.updateValue(static_cast<int64_t>(config.recurrent_dim));
+    hash.updateValue(static_cast<uint8_t>(config.sparse_resonance_updates));
+    hash.updateValue(static_cast<int64_t>(std::max(config.sampled_softmax_negatives, 0)));
+    return hash.digest();
+}
+
+// The optimizer's parameters under their DaoModel::namedTensors() keys, which name their Adam
+// state in checkpoints.
+static std::vector<std::pair<std::string, torch::Tensor>> name_parameters(const DaoModel& model,
+                                                                          const std::vector<torch::Tensor>& parameters) {
+    const auto named_tensors = model.namedTensors();
+    std::vector<std::pair<std::string, torch::Tensor>> named;
+    for (const auto& parameter : parameters) {
+        auto found = std::find_if(named_tensors.begin(), named_tensors.end(), [&](const auto& candidate) {
+            return candidate.second.unsafeGetTensorImpl() == parameter.unsafeGetTensorImpl();
+        });
+        if (found == named_tensors.end()) throw std::logic_error("Optimizer parameter is not one of the model's tensors.");
+        named.emplace_back(found->first, parameter);
+    }
+    return named;
+}
+
+void train_model(DaoModel &model, TextSdrEncoder &encoder, const std::vector<int> &corpus_token_ids, const std::vector<int> &validation_token_ids, const TrainingConfig &config) {
     torch::Device device(torch::kCPU);
     if (torch::cuda::is_available()) {
         device = torch::kCUDA;
@@ -79,9 +397,11 @@ void train_model(DaoModel &model, TextSdrEncoder &encoder, const std::vector<int
     
     // Construct the model structure regardless of training or loading
     if (model.spatial_poolers.empty()) {
-        model.spatial_poolers.emplace_back(concatenated_input_size, column_count, 0);
+        model.spatial_poolers.emplace_back(concatenated_input_size, column_count, 0, 0.5f, 0.01f, 0.005f, 0.5f, 10, 5, 1,
+                                           config.sp_synapse_storage);
         model.resonance_layers.emplace_back(column_count, column_count, device);
-        model.temporal_memories.emplace_back(column_count, column_count, device);
+        model.temporal_memories.emplace_back(column_count, column_count, device,
+                                             config.recurrent_structure, config.recurrent_dim);
         auto options = torch::TensorOptions().dtype(torch::kFloat32).device(device).requires_grad(true);
         model.vocab_matrix = torch::empty({encoder.getVocabSize(), column_count}, options);
         torch::nn::init::normal_(model.vocab_matrix, 0.0, 0.01);
@@ -93,91 +413,369 @@ void train_model(DaoModel &model, TextSdrEncoder &encoder, const std::vector<int
     }
     
     std::cout << "Training on " << device << "." << std::endl;
-    
-    const int epochs = 20; // [SLLM] Increased default epochs
-    const float learning_rate = 1e-4;
+
+    const int epochs = config.epochs;
+    const float learning_rate = config.learning_rate;
+
+    // --- Mini-batch layout: B contiguous streams of `stream_length` tokens each ---
+    const size_t num_targets = corpus_token_ids.size() - 1;
+    const int batch_size = static_cast<int>(std::min<size_t>(std::max(config.batch_size, 1), std::max<size_t>(num_targets, 1)));
+    const size_t stream_length = num_targets / batch_size;
+    const size_t bptt_steps = static_cast<size_t>(std::max(config.bptt_steps, 1));
+    const long long metrics_interval = config.metrics_interval;
+    std::cout << "Mini-batches: " << batch_size << " streams x " << bptt_steps << " unrolled steps ("
+              << stream_length * batch_size << " of " << num_targets << " tokens per epoch)." << std::endl;
+
+    // Resume: the model (SP included) comes back first, since the optimizer below binds to
+    // the loaded tensors; its moments are restored once it exists. A checkpoint from a different
+    // run (other corpus, vocabulary, layout or optimizer setup) is ignored, not continued.
+    const uint64_t fingerprint = training_fingerprint(corpus_token_ids, encoder, batch_size, bptt_steps, config);
+    TrainingState resume_state;
+    std::unique_ptr<CheckpointReader> checkpoint;
+    if (config.resume && !config.checkpoint_path.empty() && std::filesystem::exists(config.checkpoint_path)) {
+        try {
+            checkpoint = std::make_unique<CheckpointReader>(config.checkpoint_path);
+            resume_state = checkpoint->restoreState(device);
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: could not read checkpoint " << config.checkpoint_path << " (" << e.what()
+                      << "); starting a fresh run." << std::endl;
+            checkpoint.reset();
+            resume_state = TrainingState();
+        }
+        if (checkpoint && resume_state.fingerprint != fingerprint) {
+            std::cerr << "Warning: checkpoint " << config.checkpoint_path
+                      << " belongs to a different run (corpus, vocabulary, layout or optimizer setup); starting a fresh run."
+                      << std::endl;
+            checkpoint.reset();
+            resume_state = TrainingState();
+        }
+        if (checkpoint) {
+            std::cout << "Resuming from checkpoint " << config.checkpoint_path << "." << std::endl;
+            checkpoint->restoreModel(model, device);
+        }
+    }
 
     // --- [SLLM] Early stopping parameters ---
-    const int patience = 2; // Stop after 2 epochs with no improvement
-    int epochs_without_improvement = 0;
-    double best_validation_accuracy = -1.0;
+    const int patience = config.patience;
+    int epochs_without_improvement = resume_state.epochs_without_improvement;
+    double best_validation_accuracy = resume_state.best_validation_accuracy;
     // ---
 
+    // With sparse resonance updates the RL weights are left out of the dense Adam: each chunk
+    // gathers the columns it touches into a leaf and a lazy column Adam updates just those.
+    // Sampled softmax does the same for the vocab rows (targets and negatives), so the
+    // optimizer no longer sweeps the whole vocabulary every step either.
+    const int negatives_per_chunk = std::max(config.sampled_softmax_negatives, 0);
     std::vector<torch::Tensor> parameters;
-    parameters.push_back(model.resonance_layers[0].getWeights());
+    if (!config.sparse_resonance_updates) parameters.push_back(model.resonance_layers[0].getWeights());
     auto tm_params = model.temporal_memories[0].getParameters();
     parameters.insert(parameters.end(), tm_params.begin(), tm_params.end());
-    parameters.push_back(model.vocab_matrix);
+    if (negatives_per_chunk == 0) parameters.push_back(model.vocab_matrix);
+    const auto named_parameters = name_parameters(model, parameters);
 
+    // Holds the dense parameters' Adam state and options; masked_adam_step applies the update.
     torch::optim::Adam optimizer(parameters, torch::optim::AdamOptions(learning_rate));
+    if (checkpoint) {
+        checkpoint->restoreOptimizer(named_parameters, optimizer, device);
+    }
+    auto restore_lazy_state = [&](SparseColumnAdam& lazy_optimizer, const std::string& prefix) {
+        if (!checkpoint) return;
+        auto lazy_state = lazy_optimizer.namedState();
+        bool complete = true;
+        for (auto& named : lazy_state) complete = checkpoint->tryRead(prefix + named.first, named.second) && complete;
+        if (complete) lazy_optimizer.loadState(lazy_state);
+    };
+    std::unique_ptr<SparseColumnAdam> column_optimizer;
+    if (config.sparse_resonance_updates) {
+        column_optimizer = std::make_unique<SparseColumnAdam>(model.resonance_layers[0].getWeights(), learning_rate);
+        restore_lazy_state(*column_optimizer, "");
+    }
+    // Vocab rows are the columns of vocab_matrix^T; the transpose is a view, so updates land in place.
+    std::unique_ptr<SparseColumnAdam> vocab_optimizer;
+    if (negatives_per_chunk > 0) {
+        vocab_optimizer = std::make_unique<SparseColumnAdam>(model.vocab_matrix.detach().t(), learning_rate);
+        restore_lazy_state(*vocab_optimizer, "vocab_rows_");
+    }
+    checkpoint.reset();
     auto criterion = torch::nn::CrossEntropyLoss();
 
+    // Sampled softmax: negatives come from the corpus unigram distribution, drawn per chunk
+    // by the prefetch workers; the loss needs log(S * q(id)) for the logQ correction.
+    std::unique_ptr<UnigramSampler> negative_sampler;
+    torch::Tensor log_expected_count;
+    if (negatives_per_chunk > 0) {
+        negative_sampler = std::make_unique<UnigramSampler>(corpus_token_ids, encoder.getVocabSize(),
+                                                            config.sampled_softmax_power);
+        std::vector<double> expected_counts = negative_sampler->probabilities();
+        for (double& q : expected_counts) q *= negatives_per_chunk;
+        log_expected_count = torch::tensor(expected_counts, torch::TensorOptions().dtype(torch::kDouble))
+                                 .log().to(device, torch::kFloat);
+        std::cout << "Sampled softmax: " << negatives_per_chunk << " negatives per chunk of "
+                  << encoder.getVocabSize() << " pieces." << std::endl;
+    }
+
     GridCellEncoder position_encoder(position_sdr_size, static_cast<int>(position_sdr_size * 0.02));
     position_encoder.addModule(50.0, 101);
 
-    for (int epoch = 0; epoch < epochs; ++epoch) {
+    SpatialPooler& sp = model.spatial_poolers[0];
+    ResonanceLayer& rl = model.resonance_layers[0];
+    TemporalMemory& tm = model.temporal_memories[0];
+
+    // The SP is frozen, so each position's basis SDR is the same in every epoch (and every run
+    // with the same model): compute them once into memory-mapped caches.
+    BasisCache corpus_cache;
+    BasisCache validation_cache;
+    if (config.use_basis_cache && BasisCache::supports(sp.getNumColumns())) {
+        corpus_cache = open_basis_cache("./basis_train.cache", corpus_token_ids, sp, encoder, position_encoder);
+        validation_cache = open_basis_cache("./basis_validate.cache", validation_token_ids, sp, encoder, position_encoder);
+    }
+
+    // Encoding and the frozen SP do not depend on the trained parameters, so worker threads
+    // build chunks (across epoch boundaries too) while this thread runs forward/backward.
+    const long long chunks_per_epoch = static_cast<long long>((stream_length + bptt_steps - 1) / bptt_steps);
+    auto build_chunk = [&](long long chunk_index, PrefetchedChunk& out) {
+        const size_t chunk_start = static_cast<size_t>(chunk_index % chunks_per_epoch) * bptt_steps;
+        const size_t steps = std::min(bptt_steps, stream_length - chunk_start);
+        std::vector<size_t> positions;
+        positions.reserve(steps * batch_size);
+        out.targets.clear();
+
+        // Column t*B + b holds stream b at step t.
+        for (size_t t = 0; t < steps; ++t) {
+            for (int b = 0; b < batch_size; ++b) {
+                const size_t i = b * stream_length + chunk_start + t;
+                positions.push_back(i);
+                out.targets.push_back(corpus_token_ids[i + 1]);
+            }
+        }
+        out.basis_sdrs = basis_sdrs_for(positions, corpus_token_ids, sp, encoder, position_encoder, &corpus_cache);
+
+        out.columns.clear();
+        for (const auto& basis_sdr : out.basis_sdrs) {
+            out.columns.insert(out.columns.end(), basis_sdr.active.begin(), basis_sdr.active.end());
+        }
+        std::sort(out.columns.begin(), out.columns.end());
+        out.columns.erase(std::unique(out.columns.begin(), out.columns.end()), out.columns.end());
+
+        // Seeded by chunk index, so the draws do not depend on which worker builds the chunk.
+        out.negatives.clear();
+        if (negative_sampler) {
+            std::mt19937_64 rng(0x5eed0000ull + static_cast<uint64_t>(chunk_index));
+            negative_sampler->sample(rng, negatives_per_chunk, out.negatives);
+        }
+
+        // The vocab rows the sampled loss reads, and each target's and negative's slot among them.
+        out.vocab_rows.clear();
+        out.target_slots.clear();
+        out.negative_slots.clear();
+        if (negative_sampler) {
+            out.vocab_rows = out.targets;
+            out.vocab_rows.insert(out.vocab_rows.end(), out.negatives.begin(), out.negatives.end());
+            std::sort(out.vocab_rows.begin(), out.vocab_rows.end());
+            out.vocab_rows.erase(std::unique(out.vocab_rows.begin(), out.vocab_rows.end()), out.vocab_rows.end());
+            auto slot_of = [&](int64_t id) {
+                return static_cast<int64_t>(std::lower_bound(out.vocab_rows.begin(), out.vocab_rows.end(), id) -
+                                            out.vocab_rows.begin());
+            };
+            for (int64_t id : out.targets) out.target_slots.push_back(slot_of(id));
+            for (int64_t id : out.negatives) out.negative_slots.push_back(slot_of(id));
+        }
+    };
+    const long long first_chunk = std::min(resume_state.epoch * chunks_per_epoch + resume_state.next_chunk,
+                                           chunks_per_epoch * epochs);
+    BasisPrefetcher prefetcher(chunks_per_epoch * epochs - first_chunk,
+                               [&](long long chunk_index, PrefetchedChunk& out) { build_chunk(first_chunk + chunk_index, out); },
+                               config.prefetch_depth, config.prefetch_workers);
+
+    // Checkpoints and best-model files are written in the background, one writer each so
+    // the two can overlap.
+    CheckpointWriter checkpoint_writer;
+    CheckpointWriter best_model_writer;
+    auto flush_lazy_optimizers = [&]() {
+        if (column_optimizer) column_optimizer->flush();
+        if (vocab_optimizer) vocab_optimizer->flush();
+    };
+    auto save_checkpoint = [&](TrainingState state) {
+        if (config.checkpoint_path.empty()) return;
+        state.epochs_without_improvement = epochs_without_improvement;
+        state.best_validation_accuracy = best_validation_accuracy;
+        state.fingerprint = fingerprint;
+        // Lazily updated columns are caught up first so the checkpoint's weights are dense Adam's
+        // (flushing mid-epoch does not change the trajectory, it only does the catch-up early).
+        flush_lazy_optimizers();
+        std::vector<std::pair<std::string, torch::Tensor>> lazy_state;
+        if (column_optimizer) lazy_state = column_optimizer->namedState();
+        if (vocab_optimizer) {
+            for (auto& named : vocab_optimizer->namedState()) lazy_state.emplace_back("vocab_rows_" + named.first, named.second);
+        }
+        checkpoint_writer.save(config.checkpoint_path, model, named_parameters, optimizer, state, lazy_state);
+    };
+
+    for (int epoch = resume_state.epoch; epoch < epochs; ++epoch) {
         std::cout << "\n--- Epoch " << epoch + 1 << "/" << epochs << " ---" << std::endl;
-        model.temporal_memories[0].resetStates();
+        const bool resuming_epoch = epoch == resume_state.epoch && resume_state.next_chunk > 0;
+        torch::Tensor hidden = resuming_epoch ? resume_state.hidden : tm.initialState(batch_size);
         double total_loss = 0.0;
         int processed_tokens = 0;
 
-        ProgressBar train_bar(corpus_token_ids.size() - 1, "  Training");
-
-        for (size_t i = 0; i < corpus_token_ids.size() - 1; ++i) {
-            int current_token_id = corpus_token_ids[i];
-            int target_token_id = corpus_token_ids[i+1];
-
-            SDR token_sdr = encoder.encodeSingleToken(current_token_id);
-            std::vector<double> coordinates = {static_cast<double>(i), static_cast<double>(i)};
-            SDR position_sdr = position_encoder.encode(coordinates);
-            SDR concatenated_sdr = token_sdr;
-            concatenated_sdr.insert(concatenated_sdr.end(), position_sdr.begin(), position_sdr.end());
-            
-            SDR basis_sdr = model.spatial_poolers[0].process(concatenated_sdr, false);
-            torch::Tensor rdr = model.resonance_layers[0].process(basis_sdr);
-            model.temporal_memories[0].process(rdr);
-            
-            torch::Tensor predictive_state = model.temporal_memories[0].getPredictiveState();
-            torch::Tensor logits = torch::matmul(model.vocab_matrix, predictive_state).squeeze();
-            logits = torch::clamp(logits, -15.0f, 15.0f);
-
-            torch::Tensor target = torch::tensor({target_token_id}, torch::TensorOptions().dtype(torch::kLong).device(device));
-            torch::Tensor loss = criterion(logits.unsqueeze(0), target);
-            
-            if (torch::isnan(loss).item<bool>()) {
-                std::cerr << "Warning: NaN loss detected at step " << i << ". Skipping update." << std::endl;
-                continue;
+        ProgressBar train_bar(stream_length * batch_size, "  Training");
+
+        // Loss and skip counts stay on device and are read back every `metrics_interval` steps.
+        auto device_options = torch::TensorOptions().device(device);
+        torch::Tensor loss_sum = torch::zeros({}, device_options.dtype(torch::kDouble));
+        torch::Tensor token_count = torch::zeros({}, device_options.dtype(torch::kLong));
+        torch::Tensor skipped_chunks = torch::zeros({}, device_options.dtype(torch::kLong));
+        TrainingMetrics metrics;
+        long long attempted_tokens = 0;
+        long long step = 0;
+        size_t first_chunk_start = 0;
+        if (resuming_epoch) {
+            loss_sum = resume_state.loss_sum;
+            token_count = resume_state.token_count;
+            skipped_chunks = resume_state.skipped_chunks;
+            attempted_tokens = resume_state.attempted_tokens;
+            step = resume_state.step;
+            // The checkpointed Adam step counters already had these skips discounted.
+            metrics.read(loss_sum, token_count, skipped_chunks);
+            first_chunk_start = static_cast<size_t>(resume_state.next_chunk) * bptt_steps;
+            train_bar.update(attempted_tokens);
+        }
+        const long long resumed_tokens = attempted_tokens;
+        long long reported_skips = metrics.skipped;
+        auto epoch_start = std::chrono::steady_clock::now();
+        auto report_metrics = [&](long long tokens_seen) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch_start).count();
+            std::ostringstream postfix;
+            postfix << "loss " << std::fixed << std::setprecision(4)
+                    << (metrics.tokens > 0 ? metrics.loss_sum / metrics.tokens : 0.0)
+                    << " | " << std::setprecision(0) << (seconds > 0.0 ? (tokens_seen - resumed_tokens) / seconds : 0.0)
+                    << " tok/s";
+            train_bar.setPostfix(postfix.str());
+            if (metrics.skipped > reported_skips) {
+                std::cerr << "\nWarning: " << metrics.skipped - reported_skips
+                          << " chunk(s) with a non-finite loss were skipped." << std::endl;
+                discount_adam_steps(optimizer, metrics.skipped - reported_skips);
+                reported_skips = metrics.skipped;
+            }
+        };
+        for (size_t chunk_start = first_chunk_start; chunk_start < stream_length; chunk_start += bptt_steps) {
+            const size_t steps = std::min(bptt_steps, stream_length - chunk_start);
+            const size_t chunk_size = steps * batch_size;
+            const PrefetchedChunk& chunk = prefetcher.next();
+            const std::vector<int64_t>& targets = chunk.targets;
+
+            // One graph over the chunk: RL gather and hoisted TM input projection.
+            torch::Tensor rdrs;                                        // [rdr, T*B]
+            torch::Tensor column_index;
+            torch::Tensor column_weights;
+            if (column_optimizer) {
+                column_index = torch::tensor(chunk.columns, torch::TensorOptions().dtype(torch::kLong)).to(device);
+                column_weights = column_optimizer->gather(column_index);
+                rdrs = rl.processBatch(chunk.basis_sdrs, chunk.columns, column_weights);
+            } else {
+                rdrs = rl.processBatch(chunk.basis_sdrs);
             }
+            torch::Tensor states = tm.forwardSequence(rdrs, hidden);   // [cells, T*B]
+            hidden = states.narrow(1, static_cast<int64_t>(chunk_size - batch_size), batch_size);
 
+            // Rows are ordered (t, b), matching `targets`.
+            torch::Tensor target = torch::tensor(targets, torch::TensorOptions().dtype(torch::kLong)).to(device);
+            torch::Tensor loss;
+            torch::Tensor vocab_index;
+            torch::Tensor vocab_weights;
+            if (vocab_optimizer) {
+                vocab_index = torch::tensor(chunk.vocab_rows, torch::TensorOptions().dtype(torch::kLong)).to(device);
+                vocab_weights = vocab_optimizer->gather(vocab_index);                  // [cells, rows]
+                torch::Tensor target_slots = torch::tensor(chunk.target_slots, torch::TensorOptions().dtype(torch::kLong)).to(device);
+                torch::Tensor negative_slots = torch::tensor(chunk.negative_slots, torch::TensorOptions().dtype(torch::kLong)).to(device);
+                loss = sampled_softmax_loss(vocab_weights.t(), states, target_slots, negative_slots,
+                                            log_expected_count.index_select(0, vocab_index), criterion);
+            } else {
+                torch::Tensor logits = torch::matmul(model.vocab_matrix, states).t();
+                logits = torch::clamp(logits, -15.0f, 15.0f);
+                loss = criterion(logits, target);
+            }
+
+            // Non-finite chunks are masked on device instead of branched on: their gradients are
+            // zeroed (so they cannot poison the clip norm), the optimizer update is discarded by
+            // masked_adam_step, and the recurrent state restarts from zero so a non-finite state
+            // cannot carry into the next chunk (the old host-side skip kept it).
+            torch::Tensor finite = torch::isfinite(loss.detach());
             optimizer.zero_grad();
             loss.backward();
-            torch::nn::utils::clip_grad_norm_(parameters, 1.0);
-            optimizer.step();
+            std::vector<torch::Tensor> trained = parameters;
+            if (column_weights.defined()) trained.push_back(column_weights);
+            if (vocab_weights.defined()) trained.push_back(vocab_weights);
+            for (auto& parameter : trained) {
+                if (parameter.grad().defined()) parameter.grad().masked_fill_(finite.logical_not(), 0.0);
+            }
+            clip_grad_norm_on_device(trained, 1.0);
+            masked_adam_step(optimizer, parameters, finite);
+            if (column_optimizer) column_optimizer->step(column_index, column_weights.grad(), finite);
+            if (vocab_optimizer) vocab_optimizer->step(vocab_index, vocab_weights.grad(), finite);
+
+            // Truncate: the next chunk starts from these states but does not backprop into them.
+            hidden = torch::where(finite, hidden.detach(), torch::zeros_like(hidden));
 
-            total_loss += loss.item<double>();
-            processed_tokens++;
-            train_bar.update(i + 1);
+            const int chunk_tokens = static_cast<int>(targets.size());
+            loss_sum += torch::where(finite, loss.detach().to(torch::kDouble) * chunk_tokens, torch::zeros_like(loss_sum));
+            token_count += finite.to(torch::kLong) * chunk_tokens;
+            skipped_chunks += finite.logical_not().to(torch::kLong);
+            attempted_tokens += chunk_tokens;
+            ++step;
+
+            const bool checkpoint_due = config.checkpoint_interval > 0 && step % config.checkpoint_interval == 0 &&
+                                        chunk_start + bptt_steps < stream_length;
+            if ((metrics_interval > 0 && step % metrics_interval == 0) || checkpoint_due) {
+                metrics.read(loss_sum, token_count, skipped_chunks);
+                report_metrics(attempted_tokens);
+            }
+            if (checkpoint_due) {
+                TrainingState state;
+                state.epoch = epoch;
+                state.next_chunk = static_cast<long long>(chunk_start / bptt_steps) + 1;
+                state.hidden = hidden;
+                state.loss_sum = loss_sum;
+                state.token_count = token_count;
+                state.skipped_chunks = skipped_chunks;
+                state.attempted_tokens = attempted_tokens;
+                state.step = step;
+                save_checkpoint(state);
+            }
+            train_bar.update(attempted_tokens);
         }
+        metrics.read(loss_sum, token_count, skipped_chunks);
+        report_metrics(attempted_tokens);
+        total_loss = metrics.loss_sum;
+        processed_tokens = static_cast<int>(metrics.tokens);
         train_bar.done();
+        // Bring the columns the lazy optimizers skipped up to date before the weights are evaluated and saved.
+        flush_lazy_optimizers();
         if(processed_tokens == 0) continue;
 
         std::cout << "   - Average Training Loss: " << std::fixed << std::setprecision(4) << (total_loss / processed_tokens) << std::endl;
         
         // --- [SLLM] Early stopping logic ---
-        double current_accuracy = evaluate_model(model, encoder, validation_token_ids, device, true);
+        double current_accuracy = evaluate_model_detailed(model, encoder, validation_token_ids, device,
+                                                          config.evaluation, true, &validation_cache).top1_accuracy;
 
         if (current_accuracy > best_validation_accuracy) {
             best_validation_accuracy = current_accuracy;
             epochs_without_improvement = 0;
             std::cout << "   -> New best validation accuracy. Saving checkpoint to model_best.bin" << std::endl;
-            model.save("./model_best.bin"); // Save the best model checkpoint
+            best_model_writer.saveModel("./model_best.bin", model); // Save the best model checkpoint
         } else {
             epochs_without_improvement++;
             std::cout << "   -> Validation accuracy did not improve for "
                       << epochs_without_improvement << " epoch(s)." << std::endl;
         }
 
-        if (epochs_without_improvement >= patience) {
+        const bool stop_early = epochs_without_improvement >= patience;
+        TrainingState state;
+        state.epoch = stop_early ? epochs : epoch + 1;
+        save_checkpoint(state);
+
+        if (stop_early) {
             std::cout << "\n--- Early stopping triggered after " << patience
                       << " epochs without improvement. ---" << std::endl;
             break; // Exit the epoch loop
@@ -185,8 +783,20 @@ void train_model(DaoModel &model, TextSdrEncoder &encoder, const std::vector<int
         // ---
     }
     
+    prefetcher.shutdown();
+    checkpoint_writer.wait();
+    best_model_writer.wait();
+
     // --- [SLLM] Load the best model before final save ---
     std::cout << "\n--- Assimilation Complete. Loading best model and saving final state. ---" << std::endl;
-    model.load("./model_best.bin", device);
+    if (std::filesystem::exists("./model_best.bin")) model.load("./model_best.bin", device);
     model.save("./model.bin");
+    // The run is complete; a later train_model call starts a fresh one.
+    if (!config.checkpoint_path.empty()) std::filesystem::remove(config.checkpoint_path);
+
+    std::cout << "\n--- Final evaluation of the best model ---" << std::endl;
+    const double final_accuracy = evaluate_model(model, encoder, validation_token_ids, device, true, &validation_cache);
+    if (config.report_quantization) {
+        report_quantization_accuracy(model, encoder, validation_token_ids, final_accuracy);
+    }
 }
\ No newline at end of file
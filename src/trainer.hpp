@@ -7,20 +7,133 @@
 #include <vector>
 #include <string>
 
+// How evaluate_model_detailed walks the validation tokens.
+struct EvaluationConfig {
+    // The tokens are split into `shards` contiguous shards evaluated side by side as one batch;
+    // each shard first feeds the `warmup_tokens` tokens before it without scoring them, so its
+    // state is not cold. shards = 1 is the exact sequential evaluation (warm-up unused).
+    int shards = 1;
+    int warmup_tokens = 128;
+    int top_k = 5;
+};
+
+struct EvaluationResult {
+    long long predictions = 0;
+    long long top1_correct = 0;
+    double top1_accuracy = 0.0; // Percent
+    double topk_accuracy = 0.0; // Percent
+    double perplexity = 0.0;
+};
+
+// Hyperparameters and schedule for train_model.
+struct TrainingConfig {
+    int epochs = 20;
+    float learning_rate = 1e-4f;
+    int patience = 2; // Stop after this many epochs with no validation improvement
+
+    // Truncated BPTT over mini-batches: the corpus is split into `batch_size` parallel
+    // streams, the recurrence is unrolled for `bptt_steps` tokens, and each [B, T] chunk
+    // is one optimizer step. The default batch_size = bptt_steps = 1 is the original
+    // per-token schedule. Mini-batching is opt-in: a B x T chunk makes ~B*T fewer optimizer
+    // updates per epoch (and drops up to B - 1 tail tokens), so learning_rate and patience
+    // need retuning along with it.
+    int batch_size = 1;
+    int bptt_steps = 1;
+
+    // Loss, token and skip totals are accumulated on device and read back (one host sync)
+    // every `metrics_interval` optimizer steps and at the end of each epoch.
+    int metrics_interval = 50;
+
+    // Chunks are encoded and pooled by `prefetch_workers` background threads, up to
+    // `prefetch_depth` chunks ahead of the optimizer. 0 workers builds them inline.
+    int prefetch_depth = 8;
+    int prefetch_workers = 2;
+
+    // Keep the basis SDRs of every corpus / validation position in memory-mapped files
+    // (./basis_train.cache, ./basis_validate.cache) instead of recomputing them each epoch.
+    bool use_basis_cache = true;
+
+    // Recurrent parameterization of the TemporalMemory built for a new model; `recurrent_dim`
+    // is the rank or block size (0 = default). Loaded models keep the structure they were saved with.
+    TemporalMemory::RecurrentStructure recurrent_structure = TemporalMemory::RecurrentStructure::Dense;
+    int recurrent_dim = 0;
+
+    // Synapse storage of the SpatialPooler built for a new model (Quantized: one uint8 per
+    // synapse). Loaded models keep the storage they were saved with.
+    SpatialPooler::SynapseStorage sp_synapse_storage = SpatialPooler::SynapseStorage::Float;
+
+    // Update the ResonanceLayer with a lazy column-sparse Adam (SparseColumnAdam) that only
+    // touches the basis columns a chunk activates, instead of dense Adam over the full matrix.
+    bool sparse_resonance_updates = true;
+
+    // Sampled softmax: with `sampled_softmax_negatives` > 0 each chunk scores its targets against
+    // that many shared negatives drawn from the corpus unigram distribution (count^power), with
+    // the logQ correction, instead of the full vocabulary. The reported training loss is then the
+    // sampled loss. Evaluation always uses the full softmax. The vocab rows then leave the dense
+    // Adam too: a lazy row Adam (SparseColumnAdam on vocab_matrix^T) updates only the chunk's
+    // targets and negatives.
+    int sampled_softmax_negatives = 0;
+    double sampled_softmax_power = 0.75;
+
+    // Model, Adam moments and loop state are checkpointed in the background to `checkpoint_path`
+    // after every epoch and every `checkpoint_interval` optimizer steps (0 = epoch ends only).
+    // With `resume`, an existing checkpoint is continued from where it was written. The file
+    // is removed once the run completes. An empty path disables checkpointing.
+    std::string checkpoint_path = "./training_checkpoint.bin";
+    int checkpoint_interval = 1000;
+    bool resume = true;
+
+    // Per-epoch validation (early stopping) runs sharded for speed; the final numbers after
+    // training are always from the exact sequential evaluation.
+    EvaluationConfig evaluation{16, 128, 5};
+
+    // After training, also run report_quantization_accuracy (three InferenceEngine builds and
+    // three sequential validation passes). Off by default: it is a diagnostic, not training.
+    bool report_quantization = false;
+};
+
 // [SLLM REFACTORED] The main training function, now simplified for the new architecture.
 void train_model(
     DaoModel &model,
     TextSdrEncoder &encoder,
     const std::vector<int> &corpus_token_ids,
-    const std::vector<int> &validation_token_ids
+    const std::vector<int> &validation_token_ids,
+    const TrainingConfig &config = TrainingConfig()
 );
 
+class BasisCache;
+
 // [SLLM REFACTORED] The evaluation function, adapted for the RDR architecture.
+// With an open `basis_cache` the validation basis SDRs are read from it instead of recomputed.
 double evaluate_model(
     DaoModel &model,
     TextSdrEncoder &encoder,
     const std::vector<int> &validation_token_ids,
-    bool verbose = true
+    torch::Device device,
+    bool verbose = true,
+    const BasisCache* basis_cache = nullptr
+);
+
+// Top-1 / top-k accuracy and perplexity over the validation tokens, exact or sharded as
+// `config` says. evaluate_model is the exact mode's top-1 accuracy.
+EvaluationResult evaluate_model_detailed(
+    DaoModel &model,
+    TextSdrEncoder &encoder,
+    const std::vector<int> &validation_token_ids,
+    torch::Device device,
+    const EvaluationConfig &config,
+    bool verbose = true,
+    const BasisCache* basis_cache = nullptr
+);
+
+// Post-training quantization report: top-1 accuracy of the CPU InferenceEngine with its
+// weights in fp32, bf16 and int8, each against evaluate_model's baseline (computed here
+// unless a non-negative `baseline_accuracy` is passed in).
+void report_quantization_accuracy(
+    DaoModel &model,
+    TextSdrEncoder &encoder,
+    const std::vector<int> &validation_token_ids,
+    double baseline_accuracy = -1.0
 );
 
 #endif // TRAINER_HPP
\ No newline at end of file
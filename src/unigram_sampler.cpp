@@ -0,0 +1,64 @@
+// src/unigram_sampler.cpp
+#include "unigram_sampler.hpp"
+#include <cmath>
+#include <stdexcept>
+
+UnigramSampler::UnigramSampler(const std::vector<int>& token_ids, int vocab_size, double power) {
+    if (vocab_size <= 0) {
+        throw std::invalid_argument("UnigramSampler needs a positive vocabulary size.");
+    }
+    std::vector<double> counts(vocab_size, 0.0);
+    for (int id : token_ids) {
+        if (id < 0 || id >= vocab_size) {
+            throw std::out_of_range("UnigramSampler token id outside the vocabulary.");
+        }
+        counts[id] += 1.0;
+    }
+
+    double total = 0.0;
+    probabilities_.resize(vocab_size);
+    for (int id = 0; id < vocab_size; ++id) {
+        probabilities_[id] = counts[id] > 0.0 ? std::pow(counts[id], power) : 0.0;
+        total += probabilities_[id];
+    }
+    if (total <= 0.0) {
+        throw std::invalid_argument("UnigramSampler needs at least one token.");
+    }
+    for (double& p : probabilities_) p /= total;
+
+    // Vose's alias method: split buckets into under- and over-full, and let each under-full
+    // bucket borrow the rest of its mass from an over-full one.
+    accept_.resize(vocab_size);
+    alias_.resize(vocab_size);
+    std::vector<int64_t> small, large;
+    for (int id = 0; id < vocab_size; ++id) {
+        accept_[id] = probabilities_[id] * vocab_size;
+        alias_[id] = id;
+        (accept_[id] < 1.0 ? small : large).push_back(id);
+    }
+    while (!small.empty() && !large.empty()) {
+        const int64_t under = small.back();
+        small.pop_back();
+        const int64_t over = large.back();
+        alias_[under] = over;
+        accept_[over] -= 1.0 - accept_[under];
+        if (accept_[over] < 1.0) {
+            large.pop_back();
+            small.push_back(over);
+        }
+    }
+    // Whatever is left is full up to rounding.
+    for (int64_t id : small) accept_[id] = 1.0;
+    for (int64_t id : large) accept_[id] = 1.0;
+}
+
+int64_t UnigramSampler::sample(std::mt19937_64& rng) const {
+    std::uniform_int_distribution<int64_t> bucket(0, static_cast<int64_t>(accept_.size()) - 1);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    const int64_t id = bucket(rng);
+    return coin(rng) < accept_[id] ? id : alias_[id];
+}
+
+void UnigramSampler::sample(std::mt19937_64& rng, int count, std::vector<int64_t>& out) const {
+    for (int i = 0; i < count; ++i) out.push_back(sample(rng));
+}
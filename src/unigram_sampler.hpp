@@ -0,0 +1,34 @@
+// src/unigram_sampler.hpp
+#ifndef UNIGRAM_SAMPLER_HPP
+#define UNIGRAM_SAMPLER_HPP
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Draws token ids from the corpus unigram distribution in O(1) per sample.
+ *
+ * q(id) is proportional to count(id)^power (power 1 is the plain unigram, 0.75 the usual
+ * flattened one for negative sampling). Sampling uses Vose's alias table, so the cost
+ * does not grow with the vocabulary. Const and stateless: callers pass their own engine,
+ * so several threads can sample at once.
+ */
+class UnigramSampler {
+public:
+    UnigramSampler(const std::vector<int>& token_ids, int vocab_size, double power = 1.0);
+
+    int64_t sample(std::mt19937_64& rng) const;
+    // Appends `count` samples (with replacement) to `out`.
+    void sample(std::mt19937_64& rng, int count, std::vector<int64_t>& out) const;
+
+    // q(id) for every id, summing to 1.
+    const std::vector<double>& probabilities() const { return probabilities_; }
+
+private:
+    std::vector<double> probabilities_;
+    std::vector<double> accept_; // Chance of keeping the drawn bucket rather than its alias
+    std::vector<int64_t> alias_;
+};
+
+#endif // UNIGRAM_SAMPLER_HPP